@@ -0,0 +1,86 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <asset_pattern.h>
+#include <logger.h>
+
+using namespace std;
+
+/**
+ * Construct a pattern that matches no asset
+ */
+AssetPattern::AssetPattern() : m_match(MatchExact)
+{
+}
+
+/**
+ * Compile the pattern. If the pattern can not be compiled the asset
+ * name is matched exactly.
+ *
+ * @param match		The type of matching to perform
+ * @param pattern	The pattern to match
+ * @return		True if the pattern was compiled
+ */
+bool AssetPattern::compile(AssetMatch match, const string& pattern)
+{
+	m_match = match;
+	m_pattern = pattern;
+	if (match == MatchExact)
+	{
+		return true;
+	}
+	string expression = pattern;
+	if (match == MatchWildcard)
+	{
+		expression.clear();
+		for (auto c : pattern)
+		{
+			if (c == '*')
+			{
+				expression.append(".*");
+			}
+			else if (c == '?')
+			{
+				expression.push_back('.');
+			}
+			else
+			{
+				if (string("\\^$.|+()[]{}").find(c) != string::npos)
+				{
+					expression.push_back('\\');
+				}
+				expression.push_back(c);
+			}
+		}
+	}
+	try {
+		m_regex = regex(expression, regex::ECMAScript | regex::optimize);
+	} catch (const regex_error& e) {
+		Logger::getLogger()->error("The asset pattern '%s' is not valid, %s. The asset name will be matched exactly",
+				pattern.c_str(), e.what());
+		m_match = MatchExact;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Test if an asset name matches the pattern
+ *
+ * @param name	The asset name to test
+ * @return	True if the asset name matches
+ */
+bool AssetPattern::matches(const string& name) const
+{
+	if (m_match == MatchExact)
+	{
+		return name.compare(m_pattern) == 0;
+	}
+	return regex_match(name, m_regex);
+}
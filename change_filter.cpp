@@ -12,10 +12,18 @@
 #include <utility>                
 #include <logger.h>
 #include <change_filter.h>
+#include <tracepoints.h>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
 
 using namespace std;
 using namespace rapidjson;
 
+#define MAX_GAP_BUCKETS	1000	// Limit on the empty periods sent at once
+
 /**
  * Construct a ChangeFilter, call the base class constructor and handle the
  * parsing of the configuration category the required change
@@ -26,8 +34,46 @@ ChangeFilter::ChangeFilter(const std::string& filterName,
                                OUTPUT_STREAM out) :
                                   FledgeFilter(filterName, filterConfig,
                                                 outHandle, out),
-				  m_name(filterConfig.getName()), m_state(false)
+				  m_name(filterConfig.getName()), m_state(false),
+				  m_firstCall(true), m_averageCount(0),
+				  m_lastShed(NULL), m_shedCount(0), m_shedReadings(0), m_shedBytes(0),
+				  m_windowReadings(0), m_windowShed(0),
+				  m_flushScheduled(false), m_schedulerUsed(false),
+				  m_lastAverage(NULL), m_outputQueue(NULL), m_outputThread(NULL),
+				  m_allocatedReadings(0), m_allocatedDatapoints(0), m_adoptedReadings(0),
+				  m_triggerCount(0),
+				  m_eventCount(0), m_lastValueValid(false), m_parent(NULL)
 {
+	timerclear(&m_lastSent);
+	m_coalesceReadings = 0;
+	m_coalesceTime = 0;
+	m_suppressEmpty = false;
+	m_coalesceScheduled = false;
+	m_reorderScheduled = false;
+	m_maxAssets = 1000;
+	m_parallel = 0;
+	m_pool = NULL;
+	m_shardCount = 0;
+	m_record = &m_recorder;
+	m_recordAsset = 0;
+	m_dumpRequested = false;
+	m_holdoffRecorded = false;
+	m_pruned = 0;
+	m_evicted = 0;
+	m_memoryLimit = 0;
+	m_memoryShed = 0;
+	m_memoryBreach = false;
+	m_memoryUsed = 0;
+	m_assetFilters = 0;
+	m_assetBudget = 0;
+	m_assetLimit = 0;
+	m_coalescedBytes = 0;
+	m_tableBytes = 0;
+	m_tablesChanged = true;
+	m_configBytes = 0;
+	m_activityCount = 0;
+	m_activityMean = 0.0;
+	m_activityM2 = 0.0;
 	handleConfig(filterConfig);
 }
 
@@ -36,11 +82,55 @@ ChangeFilter::ChangeFilter(const std::string& filterName,
  */
 ChangeFilter::~ChangeFilter()
 {
+	clearAssetFilters();
+	delete m_pool;
+	if (!m_reorder.empty())
+	{
+		// Process and send the readings still held for reordering
+		vector<Reading *> out;
+		{
+			lock_guard<mutex> guard(m_configMutex);
+			drainReorder(out);
+		}
+		if (!out.empty())
+		{
+			output(new ReadingSet(&out));
+		}
+	}
+	if (m_schedulerUsed)
+	{
+		FlushScheduler::getInstance()->cancel(this);
+	}
+	if (!m_coalesced.empty())
+	{
+		// Send the output still held for coalescing
+		send(new ReadingSet(&m_coalesced));
+		m_coalesced.clear();
+	}
+	{
+		lock_guard<mutex> guard(m_producerMutex);
+		stopOutputThread();
+	}
+	if (m_record == &m_recorder && m_recorder.enabled() && !m_recorderFile.empty())
+	{
+		dumpRecorder(m_recorderFile);
+	}
+	delete m_lastShed;
+	delete m_lastAverage;
+	Logger::getLogger()->debug("Filter %s allocated %llu readings and %llu datapoints, %llu readings were adopted by the pretrigger buffer",
+			m_name.c_str(), (unsigned long long)m_allocatedReadings,
+			(unsigned long long)m_allocatedDatapoints,
+			(unsigned long long)m_adoptedReadings);
 }
 
 /**
  * Called with a set of readings, iterate over the readings applying
- * the change filter to create the output readings
+ * the change filter to create the output readings.
+ *
+ * The readings are processed in a single pass, each state handling a run
+ * of readings and returning the index at which the state changed. This
+ * avoids shuffling the remainder of the vector and recursing on every
+ * trigger in very large batches.
  *
  * @param readings	The readings to process
  * @param out		The output readings
@@ -49,13 +139,499 @@ void ChangeFilter::ingest(vector<Reading *> *readings, vector<Reading *>& out)
 {
 	lock_guard<mutex> guard(m_configMutex);
 
-	if (m_state)
+	CHANGE_TRACE3(ingest_entry, m_name.c_str(), m_asset.c_str(), readings->size());
+	if (m_pattern.type() != MatchExact)
+	{
+		ingestMatched(readings, out);
+		CHANGE_TRACE2(ingest_return, m_name.c_str(), out.size());
+		return;
+	}
+	if (m_reorder.enabled() || !m_reorder.empty())
+	{
+		reorder(readings);
+		if (!m_reorder.empty())
+		{
+			scheduleRelease();
+		}
+	}
+	process(readings, out);
+	CHANGE_TRACE2(ingest_return, m_name.c_str(), out.size());
+}
+
+/**
+ * Apply the change filter to a set of readings that are in order, each
+ * state handles a run of readings and returns the index at which the
+ * state changed.
+ *
+ * @param readings	The readings to process
+ * @param out		The output readings
+ */
+void ChangeFilter::process(vector<Reading *> *readings, vector<Reading *>& out)
+{
+	out.reserve(out.size() + readings->size());
+	size_t index = 0;
+	while (index < readings->size())
 	{
-		triggeredIngest(readings, out);
+		if (m_state)
+		{
+			index = triggeredIngest(readings, index, out);
+		}
+		else
+		{
+			index = untriggeredIngest(readings, index, out);
+		}
+	}
+	readings->clear();
+}
+
+/**
+ * Process a set of readings when the asset is a pattern. Each asset that
+ * matches the pattern is monitored by a filter of its own, the decision
+ * for each distinct asset name is cached so that after the first reading
+ * of an asset the pattern is no longer evaluated. The readings of assets
+ * that do not match are passed on unaltered.
+ *
+ * Consecutive readings of the same matched asset are passed to its filter
+ * as a single run, the run is processed as soon as a reading of any other
+ * asset arrives so that the output keeps the order in which the readings
+ * arrived. At most the configured number of asset names are remembered,
+ * the asset seen least recently is forgotten to make room for a new one.
+ *
+ * @param readings	The readings to process
+ * @param out		The output readings
+ */
+void ChangeFilter::ingestMatched(vector<Reading *> *readings, vector<Reading *>& out)
+{
+MatchedAsset	*run = NULL;
+size_t		own = 0;
+
+	if (m_memoryLimit > 0)
+	{
+		// The memory left after that used by this filter is shared by the asset filters
+		own = memoryUsage();
+		m_assetBudget = own < m_memoryLimit ? m_memoryLimit - own : 0;
+		shareLimit();
+	}
+	out.reserve(out.size() + readings->size());
+	if (m_pool)
+	{
+		ingestSharded(readings, out);
 	}
 	else
 	{
-		untriggeredIngest(readings, out);
+		for (auto reading : *readings)
+		{
+			const string& name = reading->getAssetName();
+			if (run && name.compare(run->m_filter->m_asset) == 0)
+			{
+				m_run.push_back(reading);
+				continue;
+			}
+			if (run)
+			{
+				run->m_filter->ingest(&m_run, out);
+				run = NULL;
+			}
+			MatchedAsset& matched = matchAsset(name, out);
+			if (!matched.m_filter)
+			{
+				out.push_back(reading);
+				continue;
+			}
+			run = &matched;
+			m_run.push_back(reading);
+		}
+		readings->clear();
+		if (run)
+		{
+			run->m_filter->ingest(&m_run, out);
+		}
+	}
+	if (m_memoryLimit > 0)
+	{
+		size_t used = own;
+		for (auto& matched : m_matched)
+		{
+			if (matched.second.m_filter)
+			{
+				used += matched.second.m_filter->m_memoryUsed;
+			}
+		}
+		m_memoryUsed = used;
+	}
+}
+
+/**
+ * Process a set of readings when the asset is a pattern using the worker
+ * pool. The readings of each matched asset are gathered into a shard of
+ * their own and the shards are processed in parallel, the runs of an
+ * asset are processed in order by a single thread. The output of each run
+ * is then merged in the order in which the readings arrived.
+ *
+ * @param readings	The readings to process
+ * @param out		The output readings
+ */
+void ChangeFilter::ingestSharded(vector<Reading *> *readings, vector<Reading *>& out)
+{
+AssetShard	*run = NULL;
+
+	for (auto reading : *readings)
+	{
+		const string& name = reading->getAssetName();
+		if (run && name.compare(run->m_matched->m_filter->m_asset) == 0)
+		{
+			run->m_readings.push_back(reading);
+			continue;
+		}
+		if (run)
+		{
+			run->m_runs.push_back(run->m_readings.size());
+			run = NULL;
+		}
+		MatchedAsset& matched = matchAsset(name, out);
+		if (!matched.m_filter)
+		{
+			m_sequence.push_back(pair<size_t, Reading *>(SIZE_MAX, reading));
+			continue;
+		}
+		if (matched.m_shard == SIZE_MAX)
+		{
+			if (m_shardCount == m_shards.size())
+			{
+				m_shards.resize(m_shardCount + 1);
+			}
+			matched.m_shard = m_shardCount++;
+			m_shards[matched.m_shard].m_matched = &matched;
+		}
+		m_sequence.push_back(pair<size_t, Reading *>(matched.m_shard, NULL));
+		run = &m_shards[matched.m_shard];
+		run->m_readings.push_back(reading);
+	}
+	readings->clear();
+	if (run)
+	{
+		run->m_runs.push_back(run->m_readings.size());
+	}
+	runShards(out);
+}
+
+/**
+ * Process the shards gathered from a batch in parallel and merge their
+ * output, in the order in which the readings arrived, with the readings
+ * of the assets that were not matched. The shards are then emptied ready
+ * for the next batch.
+ *
+ * @param out	The output readings
+ */
+void ChangeFilter::runShards(vector<Reading *>& out)
+{
+	m_pool->run(m_shardCount, [this](size_t index) {
+		AssetShard& shard = m_shards[index];
+		ChangeFilter *filter = shard.m_matched->m_filter;
+		size_t start = 0;
+		for (auto end : shard.m_runs)
+		{
+			shard.m_run.assign(shard.m_readings.begin() + start,
+					shard.m_readings.begin() + end);
+			filter->ingest(&shard.m_run, shard.m_out);
+			shard.m_outRuns.push_back(shard.m_out.size());
+			start = end;
+		}
+	});
+	for (auto& entry : m_sequence)
+	{
+		if (entry.first == SIZE_MAX)
+		{
+			out.push_back(entry.second);
+			continue;
+		}
+		AssetShard& shard = m_shards[entry.first];
+		size_t start = shard.m_merged ? shard.m_outRuns[shard.m_merged - 1] : 0;
+		size_t end = shard.m_outRuns[shard.m_merged++];
+		out.insert(out.end(), shard.m_out.begin() + start, shard.m_out.begin() + end);
+	}
+	m_sequence.clear();
+	for (size_t i = 0; i < m_shardCount; i++)
+	{
+		AssetShard& shard = m_shards[i];
+		shard.m_matched->m_shard = SIZE_MAX;
+		shard.m_matched = NULL;
+		shard.m_readings.clear();
+		shard.m_runs.clear();
+		shard.m_out.clear();
+		shard.m_outRuns.clear();
+		shard.m_merged = 0;
+	}
+	m_shardCount = 0;
+	m_tablesChanged = true;
+}
+
+/**
+ * Find the entry for an asset name, adding it if the name has not been
+ * seen before. The pattern is evaluated for a new name and a filter is
+ * created for the asset if it matches. If the configured number of asset
+ * names are already remembered the asset seen least recently is evicted,
+ * any shards gathered so far are processed first as the evicted asset may
+ * have readings in them.
+ *
+ * @param name	The asset name
+ * @param out	The output readings
+ * @return	The entry for the asset
+ */
+MatchedAsset& ChangeFilter::matchAsset(const string& name, vector<Reading *>& out)
+{
+	auto it = m_matched.find(name);
+	if (it == m_matched.end())
+	{
+		if (m_matched.size() >= m_maxAssets)
+		{
+			if (m_shardCount || !m_sequence.empty())
+			{
+				runShards(out);
+			}
+			evictAsset();
+		}
+		it = m_matched.insert(pair<string, MatchedAsset>(name, MatchedAsset())).first;
+		m_recent.push_front(&it->first);
+		it->second.m_recent = m_recent.begin();
+		m_tablesChanged = true;
+		if (m_pattern.matches(name))
+		{
+			it->second.m_filter = createAssetFilter(name);
+			m_assetFilters++;
+			shareLimit();
+		}
+	}
+	else if (it->second.m_recent != m_recent.begin())
+	{
+		m_recent.splice(m_recent.begin(), m_recent, it->second.m_recent);
+	}
+	return it->second;
+}
+
+/**
+ * Divide the memory available to the filters of the assets that match the
+ * pattern equally between them
+ */
+void ChangeFilter::shareLimit()
+{
+	m_assetLimit = m_assetBudget / (m_assetFilters > 0 ? m_assetFilters : 1);
+}
+
+/**
+ * Create the filter for an asset that matches the asset pattern. The
+ * filter has the same configuration but monitors just the one asset
+ * and sends any output it creates outside of ingest via this filter.
+ *
+ * @param asset	The name of the asset
+ */
+ChangeFilter *ChangeFilter::createAssetFilter(const string& asset)
+{
+	ConfigCategory config(m_config);
+	config.setValue("asset", asset);
+	config.setValue("assetMatch", "exact");
+	config.setValue("asyncOutput", "false");
+	config.setValue("coalesceReadings", "0");
+	config.setValue("coalesceTime", "0");
+	config.setValue("flightRecorder", "0");
+	config.setValue("recorderFile", "");
+	config.setValue("dumpRecorder", "false");
+	config.setValue("parallelAssets", "0");
+	if (m_pool)
+	{
+		// The output of a shard is only sent once it has been merged
+		config.setValue("earlyEmit", "false");
+	}
+	ChangeFilter *filter = new ChangeFilter(FledgeFilter::m_name, config, m_data, m_func);
+	filter->m_parent = this;
+	filter->m_record = m_record;
+	filter->m_recordAsset = m_record->addAsset(asset);
+	Logger::getLogger()->info("Filter %s is monitoring asset %s", m_name.c_str(), asset.c_str());
+	return filter;
+}
+
+/**
+ * Forget the asset that was seen least recently, removing the filter that
+ * monitors it. Any readings that filter still holds for reordering are
+ * sent onwards, the triggers and shed readings it counted are kept. The
+ * asset is removed from the flight recorder.
+ */
+void ChangeFilter::evictAsset()
+{
+	auto it = m_matched.find(*m_recent.back());
+	m_recent.pop_back();
+	if (it->second.m_filter)
+	{
+		Logger::getLogger()->debug("Filter %s is no longer monitoring idle asset %s",
+				m_name.c_str(), it->first.c_str());
+		m_triggerCount += it->second.m_filter->getTriggerCount();
+		m_memoryShed += it->second.m_filter->getMemoryShed();
+		unsigned int recordAsset = it->second.m_filter->m_recordAsset;
+		delete it->second.m_filter;
+		m_record->removeAsset(recordAsset);
+		m_assetFilters--;
+		shareLimit();
+	}
+	m_matched.erase(it);
+	m_tablesChanged = true;
+}
+
+/**
+ * Return the number of times the filter has triggered, including the
+ * triggers of the filters for assets that matched the asset pattern
+ */
+uint64_t ChangeFilter::getTriggerCount() const
+{
+uint64_t	count = m_triggerCount;
+
+	for (auto& it : m_matched)
+	{
+		if (it.second.m_filter)
+		{
+			count += it.second.m_filter->getTriggerCount();
+		}
+	}
+	return count;
+}
+
+/**
+ * Return the number of pre-trigger readings discarded to keep within the
+ * memory limit, including those of the filters for assets that matched
+ * the asset pattern
+ */
+uint64_t ChangeFilter::getMemoryShed() const
+{
+uint64_t	shed = m_memoryShed;
+
+	for (auto& it : m_matched)
+	{
+		if (it.second.m_filter)
+		{
+			shed += it.second.m_filter->getMemoryShed();
+		}
+	}
+	return shed;
+}
+
+/**
+ * Remove the filters created for the assets that matched the pattern,
+ * their assets in the flight recorder and the cached decisions for all
+ * asset names
+ */
+void ChangeFilter::clearAssetFilters()
+{
+	for (auto& it : m_matched)
+	{
+		if (it.second.m_filter)
+		{
+			unsigned int recordAsset = it.second.m_filter->m_recordAsset;
+			delete it.second.m_filter;
+			m_record->removeAsset(recordAsset);
+		}
+	}
+	m_matched.clear();
+	m_recent.clear();
+	m_assetFilters = 0;
+}
+
+/**
+ * Pass the readings of the monitored asset through the reorder buffer so
+ * that they are processed in user timestamp order. Readings of other assets
+ * are not held back. The readings of the monitored asset are released at
+ * the point in the batch at which they become due, so readings that need
+ * no reordering keep their place amongst the readings of other assets. If
+ * the buffer has been disabled any readings still held are released.
+ *
+ * @param readings	The readings to process, replaced by the readings to release
+ */
+void ChangeFilter::reorder(vector<Reading *> *readings)
+{
+vector<Reading *>	ordered;
+
+	ordered.reserve(readings->size());
+	for (auto reading : *readings)
+	{
+		if (m_reorder.enabled() && reading->getAssetName().compare(m_asset) == 0)
+		{
+			m_reorder.add(reading);
+			m_reorder.release(ordered);
+		}
+		else
+		{
+			ordered.push_back(reading);
+		}
+	}
+	if (!m_reorder.enabled())
+	{
+		m_reorder.drain(ordered);
+	}
+	readings->swap(ordered);
+}
+
+/**
+ * Schedule the release of the readings held for reordering should no
+ * further readings arrive within the reorder window. Called with the
+ * configuration mutex held.
+ */
+void ChangeFilter::scheduleRelease()
+{
+	m_reorderActivity = chrono::steady_clock::now();
+	if (!m_reorderScheduled)
+	{
+		m_reorderScheduled = true;
+		m_schedulerUsed = true;
+		FlushScheduler::getInstance()->schedule(this, m_reorderActivity
+				+ chrono::milliseconds(m_reorder.lateness()), FlushReorder);
+	}
+}
+
+/**
+ * Process all the readings held for reordering. Called with the
+ * configuration mutex held.
+ *
+ * @param out	The output readings
+ */
+void ChangeFilter::drainReorder(vector<Reading *>& out)
+{
+vector<Reading *>	readings;
+
+	m_reorder.drain(readings);
+	process(&readings, out);
+}
+
+/**
+ * Called by the flush scheduler when readings have been held for reordering
+ * and no reading has arrived for the duration of the reorder window. A late
+ * reading is no longer expected, the held readings are processed and the
+ * output sent onwards directly.
+ */
+void ChangeFilter::releaseReorder()
+{
+vector<Reading *>	out;
+
+	{
+		lock_guard<mutex> guard(m_configMutex);
+		m_reorderScheduled = false;
+		if (m_reorder.empty())
+		{
+			return;
+		}
+		FlushScheduler::TimePoint due = m_reorderActivity
+				+ chrono::milliseconds(m_reorder.lateness());
+		if (chrono::steady_clock::now() < due)
+		{
+			// Readings have arrived since the release was scheduled
+			m_reorderScheduled = true;
+			FlushScheduler::getInstance()->schedule(this, due, FlushReorder);
+			return;
+		}
+		Logger::getLogger()->debug("Filter %s releasing %lu readings held for reordering",
+				m_name.c_str(), (unsigned long)m_reorder.size());
+		drainReorder(out);
+	}
+	if (!out.empty())
+	{
+		output(new ReadingSet(&out));
 	}
 }
 
@@ -64,244 +640,2202 @@ void ChangeFilter::ingest(vector<Reading *> *readings, vector<Reading *>& out)
  * in the readign becomes greater than the stop time for the forwarding.
  *
  * @param readings	The readings to process
+ * @param index		The index of the first reading to process
  * @param out		The output readings
+ * @return		The index of the first reading not processed
  */
-void ChangeFilter::triggeredIngest(vector<Reading *> *readings, vector<Reading *>& out)
+size_t ChangeFilter::triggeredIngest(vector<Reading *> *readings, size_t index, vector<Reading *>& out)
 {
-int offset = 0;
-
-	for (vector<Reading *>::const_iterator reading = readings->begin();
-						      reading != readings->end();
-						      ++reading)
+	for (; index < readings->size(); index++)
 	{
-		if ((*reading)->getAssetName().compare(m_asset) == 0)
+		Reading *reading = (*readings)[index];
+		Reading *send = reading;
+		if (reading->getAssetName().compare(m_asset) == 0)
 		{
-			evaluate(*reading); 	// A change might occur that causes the m_stopTime to be updated
+			evaluate(reading); 	// A change might occur that causes the m_stopTime to be updated
 			struct timeval tm;
-			(*reading)->getUserTimestamp(&tm);
+			reading->getUserTimestamp(&tm);
 			if ((tm.tv_sec > m_stopTime.tv_sec)
 					|| (tm.tv_sec == m_stopTime.tv_sec && tm.tv_usec > m_stopTime.tv_usec))
 			{
 				Logger::getLogger()->debug("Reached the end of the triggered time");
 				m_state = false;
-				readings->erase(readings->begin(), readings->begin() + offset);
-				return untriggeredIngest(readings, out);
+				m_holdoffRecorded = false;
+				record(RecordEnd, reading, NAN, NAN);
+				CHANGE_TRACE3(trigger_expire, m_asset.c_str(), m_triggerCount,
+						(tm.tv_sec - m_windowStart.tv_sec) * 1000
+						+ (tm.tv_usec - m_windowStart.tv_usec) / 1000);
+				if (m_rearmHoldoff > 0)
+				{
+					struct timeval holdoff;
+					holdoff.tv_sec = m_rearmHoldoff / 1000;
+					holdoff.tv_usec = (m_rearmHoldoff % 1000) * 1000;
+					timeradd(&m_stopTime, &holdoff, &m_rearmTime);
+				}
+				resetExceptions();
+				endBudgetWindow(out);
+				if (m_summary != SummaryNone)
+				{
+					emitSummary(out);
+				}
+				return index;
+			}
+			if (m_summary != SummaryNone)
+			{
+				summarise(reading);
+			}
+			if (m_summary == SummaryOnly)
+			{
+				delete reading;
+				send = NULL;
+			}
+			else if (decimate(reading))
+			{
+				send = applyBudget(reading);
+			}
+			else
+			{
+				delete reading;
+				send = NULL;
 			}
 		}
 		// We either have a different asset that should pass unaltered or
 		// we have not reached the end of the post change time period
-		out.push_back(*reading);
-		offset++;
+		if (send)
+		{
+			out.push_back(send);
+		}
+		if (m_emitPending)
+		{
+			// The reading that triggered has been handled
+			m_emitPending = false;
+			emitEarly(out);
+		}
 	}
-	readings->clear();
+	return index;
 }
 
 /**
- * Called when in the triggered state to average the readings and evaluate the
- * trigger expression. If the state changes to untrigger then the triggerIngest
- * method will be called.
+ * Called when in the untriggered state to average the readings and evaluate the
+ * trigger expression. If the state changes to triggered the index of the
+ * reading that caused the trigger is returned so that it may be processed
+ * by the triggeredIngest method.
  *
  * @param readings	The readings to process
+ * @param index		The index of the first reading to process
  * @param out		The output readings
+ * @return		The index of the first reading not processed
  */
-void ChangeFilter::untriggeredIngest(vector<Reading *> *readings, vector<Reading *>& out)
+size_t ChangeFilter::untriggeredIngest(vector<Reading *> *readings, size_t index, vector<Reading *>& out)
 {
-int	offset = 0;	// Offset within the vector
-
-	for (vector<Reading *>::const_iterator reading = readings->begin();
-						      reading != readings->end();
-						      ++reading)
+	for (; index < readings->size(); index++)
 	{
-		if ((*reading)->getAssetName().compare(m_asset) == 0)
+		Reading *reading = (*readings)[index];
+		if (reading->getAssetName().compare(m_asset) == 0)
 		{
-			if (evaluate(*reading))
+			if (evaluate(reading))
 			{
 				m_state = true;
 				clearAverage();
-				// Remove the readings we have dealt with
-				readings->erase(readings->begin(), readings->begin() + offset);
+				if (m_untriggeredMode == UntriggeredSwingingDoor)
+				{
+					flushDoors(out);
+				}
+				// The depth sent, with the readings aged out or evicted while waiting
+				record(RecordPretrigger, reading, m_pruned, m_evicted);
+				m_pruned = 0;
+				m_evicted = 0;
 				sendPretrigger(out);
 				Logger::getLogger()->debug("Send the preTrigger buffer");
-				return triggeredIngest(readings, out);
+				m_emitPending = m_earlyEmit;
+				return index;
+			}
+			if (m_untriggeredMode == UntriggeredException)
+			{
+				// The reading is reduced in place, so the buffer needs a copy
+				bufferPretrigger(reading, false);
+				if (reportByException(reading))
+				{
+					out.push_back(reading);
+				}
+				else
+				{
+					delete reading;
+				}
+			}
+			else if (m_untriggeredMode == UntriggeredSwingingDoor)
+			{
+				// The reading is reduced in place, so the buffer needs a copy
+				bufferPretrigger(reading, false);
+				if (compress(reading, out))
+				{
+					out.push_back(reading);
+				}
+				else
+				{
+					delete reading;
+				}
 			}
-			bufferPretrigger(*reading);
-			if (m_rate.tv_sec != 0 || m_rate.tv_usec != 0)
+			else
 			{
-				addAverageReading(*reading, out);
+				if (m_rate.tv_sec != 0 || m_rate.tv_usec != 0)
+				{
+					if (m_alignPeriods)
+					{
+						addAlignedReading(reading, out);
+					}
+					else
+					{
+						addAverageReading(reading, out);
+					}
+				}
+				if (!bufferPretrigger(reading, true))
+				{
+					delete reading;
+				}
 			}
-			delete *reading;
 		}
 		else
 		{
-			out.push_back(*reading);
+			out.push_back(reading);
+		}
+	}
+	return index;
+}
+
+/**
+ * If we have a preTrigger buffer defined in the configuration then
+ * keep the reading in the pretrigger buffer. Remove any readings
+ * that are older than the defined pretrigger age.
+ *
+ * A reading that the caller would otherwise delete is adopted by the
+ * buffer rather than copied, saving an allocation of the reading and
+ * each of its datapoints.
+ *
+ * @param reading	Reading to buffer
+ * @param adopt		The buffer may take ownership of the reading
+ * @return		True if the buffer took ownership of the reading
+ */
+bool ChangeFilter::bufferPretrigger(Reading *reading, bool adopt)
+{
+Reading	*t;
+struct timeval	now, t1, t2, res;
+
+	if (!pretriggering())	// No pretrigger buffering
+	{
+		return false;
+	}
+	bool evicted;
+	if (adopt)
+	{
+		evicted = m_buffer.push(reading);
+		m_adoptedReadings++;
+	}
+	else
+	{
+		evicted = m_buffer.push(new Reading(*reading));
+		countAllocation(reading);
+	}
+	if (evicted)
+	{
+		m_evicted++;
+	}
+
+	if (m_preTrigger == 0)	// Bounded by count alone
+	{
+		enforceLimit();
+		return adopt;
+	}
+
+	/*
+	 * Remove the entries from the front of the pretrigger buffer taht are
+	 * older than the pre trigger time.
+	 */
+	t2.tv_sec = m_preTrigger / 1000;
+	t2.tv_usec = (m_preTrigger % 1000) * 1000;
+	for (;;)
+	{
+		t = m_buffer.front();
+		t->getUserTimestamp(&t1);
+		reading->getUserTimestamp(&now);
+		timersub(&now, &t1, &res);
+		if (timercmp(&res, &t2, >))
+		{
+			t = m_buffer.front();
+			delete t;
+			m_buffer.pop();
+			m_pruned++;
+		}
+		else
+		{
+			break;
+		}
+	}
+	enforceLimit();
+	return adopt;
+}
+
+/**
+ * Send the pretigger buffer data
+ *
+ * @param out	The output buffer
+ */
+void ChangeFilter::sendPretrigger(vector<Reading *>& out)
+{
+	CHANGE_TRACE2(pretrigger_send, m_asset.c_str(), m_buffer.size());
+	while (!m_buffer.empty())
+	{
+		Reading *r = m_buffer.front();
+		if (m_summary == SummaryOnly)
+		{
+			delete r;
+			m_buffer.pop();
+			continue;
+		}
+		if (m_budget.enabled())
+		{
+			m_budget.charge(m_budgetBytes ? readingSize(r) : 1);
+		}
+		out.push_back(r);
+		m_buffer.pop();
+	}
+}
+
+
+/**
+ * Reduce a reading to only those datapoints that have changed by more
+ * than their deadband since the value of the datapoint was last sent.
+ * The last sent values are held in a dense array of slots, indexed by
+ * datapoint name, so each datapoint costs a single hash lookup.
+ *
+ * @param reading	The reading to reduce, modified in place
+ * @return		True if any datapoints remain to be sent
+ */
+bool ChangeFilter::reportByException(Reading *reading)
+{
+vector<Datapoint *>&	datapoints = reading->getReadingData();
+size_t			kept = 0;
+
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		Datapoint *dp = datapoints[i];
+		const string& name = dp->getName();
+		unsigned int slot;
+		unordered_map<string, unsigned int>::const_iterator it = m_slotIndex.find(name);
+		if (it == m_slotIndex.end())
+		{
+			double deadband = m_deadband;
+			map<string, double>::const_iterator db = m_deadbands.find(name);
+			if (db != m_deadbands.end())
+			{
+				deadband = db->second;
+			}
+			slot = m_slots.size();
+			m_slots.push_back(ExceptionSlot(deadband));
+			m_tablesChanged = true;
+			m_slotIndex.insert(pair<string, unsigned int>(name, slot));
+		}
+		else
+		{
+			slot = it->second;
+		}
+		ExceptionSlot& last = m_slots[slot];
+
+		bool changed = !last.m_sent;
+		DatapointValue& data = dp->getData();
+		double value;
+		if (data.getType() == DatapointValue::T_STRING)
+		{
+			string strValue = data.toString();
+			changed = changed || strValue.compare(last.m_strValue) != 0;
+			if (changed)
+			{
+				last.m_strValue = strValue;
+			}
+		}
+		else
+		{
+			if (data.getType() == DatapointValue::T_INTEGER)
+			{
+				value = (double)data.toInt();
+			}
+			else if (data.getType() == DatapointValue::T_FLOAT)
+			{
+				value = data.toDouble();
+			}
+			else if (!reduceArray(data, value))
+			{
+				// Other datapoint types are always sent
+				datapoints[kept++] = dp;
+				continue;
+			}
+			changed = changed || fabs(value - last.m_value) > last.m_deadband;
+			if (changed)
+			{
+				last.m_value = value;
+			}
+		}
+		if (changed)
+		{
+			last.m_sent = true;
+			datapoints[kept++] = dp;
+		}
+		else
+		{
+			delete dp;
+		}
+	}
+	datapoints.resize(kept);
+	return kept > 0;
+}
+
+/**
+ * Forget the last sent values of all datapoints so that the next reading
+ * of the asset is sent in full.
+ */
+void ChangeFilter::resetExceptions()
+{
+	for (auto it = m_slots.begin(); it != m_slots.end(); it++)
+	{
+		it->m_sent = false;
+	}
+}
+
+/**
+ * Compress a reading using swinging door compression of each datapoint.
+ * The deadband of the datapoint is the maximum error allowed. Readings
+ * are added to the output for any earlier points that must be archived
+ * and the reading is reduced to the datapoints that must be archived at
+ * its own time. Datapoints that are neither numeric nor strings are
+ * always sent.
+ *
+ * @param reading	The reading to compress, modified in place
+ * @param out		The output buffer to add earlier archived points to
+ * @return		True if any datapoints of the reading remain to be sent
+ */
+bool ChangeFilter::compress(Reading *reading, vector<Reading *>& out)
+{
+vector<Datapoint *>&	datapoints = reading->getReadingData();
+vector<pair<double, Datapoint *> >	previous;
+size_t			kept = 0;
+struct timeval		tm;
+
+	reading->getUserTimestamp(&tm);
+	double time = tm.tv_sec + tm.tv_usec / 1000000.0;
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		Datapoint *dp = datapoints[i];
+		const string& name = dp->getName();
+		unsigned int slot;
+		unordered_map<string, unsigned int>::const_iterator it = m_doorIndex.find(name);
+		if (it == m_doorIndex.end())
+		{
+			double deviation = m_deadband;
+			map<string, double>::const_iterator db = m_deadbands.find(name);
+			if (db != m_deadbands.end())
+			{
+				deviation = db->second;
+			}
+			slot = m_doors.size();
+			m_doors.push_back(SwingingDoor(deviation));
+			m_tablesChanged = true;
+			m_doorNames.push_back(name);
+			m_doorIndex.insert(pair<string, unsigned int>(name, slot));
+		}
+		else
+		{
+			slot = it->second;
+		}
+		SwingingDoor& door = m_doors[slot];
+
+		DatapointValue& data = dp->getData();
+		bool send;
+		if (data.getType() == DatapointValue::T_STRING)
+		{
+			send = door.update(data.toString());
+		}
+		else if (data.getType() == DatapointValue::T_INTEGER
+				|| data.getType() == DatapointValue::T_FLOAT)
+		{
+			bool integer = data.getType() == DatapointValue::T_INTEGER;
+			double value = integer ? (double)data.toInt() : data.toDouble();
+			double lastTime = door.lastTime();
+			double lastValue = door.lastValue();
+			bool lastInteger = door.lastInteger();
+			DoorArchive archive = door.update(time, value, integer);
+			if (archive == ArchivePrevious)
+			{
+				Datapoint *point;
+				if (lastInteger)
+				{
+					DatapointValue dpv((long)lastValue);
+					point = new Datapoint(name, dpv);
+				}
+				else
+				{
+					DatapointValue dpv(lastValue);
+					point = new Datapoint(name, dpv);
+				}
+				m_allocatedDatapoints++;
+				previous.push_back(pair<double, Datapoint *>(lastTime, point));
+			}
+			send = archive == ArchiveCurrent;
+		}
+		else
+		{
+			send = true;
+		}
+		if (send)
+		{
+			datapoints[kept++] = dp;
+		}
+		else
+		{
+			delete dp;
+		}
+	}
+	datapoints.resize(kept);
+	if (!previous.empty())
+	{
+		archivePoints(previous, out);
+	}
+	return kept > 0;
+}
+
+/**
+ * Archive the last value of every datapoint that has not yet been archived
+ * and forget the archived points, so that the compression restarts from
+ * the first reading after a triggered window. If there is a pretrigger
+ * buffer it already holds the last values and nothing is archived.
+ *
+ * @param out	The output buffer to add the archived points to
+ */
+void ChangeFilter::flushDoors(vector<Reading *>& out)
+{
+vector<pair<double, Datapoint *> >	points;
+
+	for (size_t i = 0; i < m_doors.size(); i++)
+	{
+		SwingingDoor& door = m_doors[i];
+		if (!pretriggering() && door.pending())
+		{
+			Datapoint *point;
+			if (door.lastInteger())
+			{
+				DatapointValue dpv((long)door.lastValue());
+				point = new Datapoint(m_doorNames[i], dpv);
+			}
+			else
+			{
+				DatapointValue dpv(door.lastValue());
+				point = new Datapoint(m_doorNames[i], dpv);
+			}
+			m_allocatedDatapoints++;
+			points.push_back(pair<double, Datapoint *>(door.lastTime(), point));
+		}
+		door.reset();
+	}
+	if (!points.empty())
+	{
+		archivePoints(points, out);
+	}
+}
+
+/**
+ * Create readings of the asset for archived points, one reading for each
+ * distinct time, in time order.
+ *
+ * @param points	The time and datapoint of each point, emptied
+ * @param out		The output buffer to add the readings to
+ */
+void ChangeFilter::archivePoints(vector<pair<double, Datapoint *> >& points, vector<Reading *>& out)
+{
+	stable_sort(points.begin(), points.end(),
+			[](const pair<double, Datapoint *>& a, const pair<double, Datapoint *>& b) {
+				return a.first < b.first;
+			});
+	size_t i = 0;
+	while (i < points.size())
+	{
+		double time = points[i].first;
+		vector<Datapoint *> datapoints;
+		for (; i < points.size() && points[i].first == time; i++)
+		{
+			datapoints.push_back(points[i].second);
+		}
+		struct timeval tm;
+		tm.tv_sec = (time_t)time;
+		tm.tv_usec = (suseconds_t)llround((time - tm.tv_sec) * 1000000.0);
+		if (tm.tv_usec >= 1000000)
+		{
+			tm.tv_sec++;
+			tm.tv_usec -= 1000000;
+		}
+		Reading *reading = new Reading(m_asset, datapoints);
+		m_allocatedReadings++;
+		reading->setUserTimestamp(tm);
+		reading->setTimestamp(tm);
+		out.push_back(reading);
+	}
+	points.clear();
+}
+
+/**
+ * Parse the per datapoint deadbands. This is a comma separated list of
+ * pairs of the form datapoint:deadband.
+ *
+ * @param deadbands	The deadbands to parse
+ */
+void ChangeFilter::parseDeadbands(const string& deadbands)
+{
+	m_deadbands.clear();
+	size_t start = 0;
+	while (start < deadbands.size())
+	{
+		size_t end = deadbands.find(',', start);
+		if (end == string::npos)
+		{
+			end = deadbands.size();
+		}
+		string item = deadbands.substr(start, end - start);
+		start = end + 1;
+		size_t first = item.find_first_not_of(' ');
+		if (first == string::npos)
+		{
+			continue;
+		}
+		size_t colon = item.rfind(':');
+		if (colon == string::npos || colon <= first)
+		{
+			Logger::getLogger()->error("Badly formed deadband '%s'", item.c_str());
+			continue;
+		}
+		string name = item.substr(first, colon - first);
+		name.erase(name.find_last_not_of(' ') + 1);
+		m_deadbands[name] = fabs(strtod(item.c_str() + colon + 1, NULL));
+	}
+}
+
+/**
+ * Parse the quantiles to estimate for each datapoint. This is a comma
+ * separated list of values between 0 and 1. The datapoint of each
+ * quantile is named with a suffix of the percentile, e.g. _p95.
+ *
+ * @param quantiles	The quantiles to parse
+ */
+void ChangeFilter::parseQuantiles(const string& quantiles)
+{
+	m_quantiles.clear();
+	m_quantileSuffixes.clear();
+	size_t start = 0;
+	while (start < quantiles.size())
+	{
+		size_t end = quantiles.find(',', start);
+		if (end == string::npos)
+		{
+			end = quantiles.size();
+		}
+		string item = quantiles.substr(start, end - start);
+		start = end + 1;
+		if (item.find_first_not_of(' ') == string::npos)
+		{
+			continue;
+		}
+		char *endp;
+		double quantile = strtod(item.c_str(), &endp);
+		if (endp == item.c_str() || quantile < 0.0 || quantile > 1.0)
+		{
+			Logger::getLogger()->error("Badly formed quantile '%s'", item.c_str());
+			continue;
+		}
+		char suffix[40];
+		snprintf(suffix, sizeof(suffix), "_p%g", quantile * 100);
+		m_quantiles.push_back(quantile);
+		m_quantileSuffixes.push_back(suffix);
+	}
+}
+
+/**
+ * Apply the output budget to a reading of the asset within a triggered
+ * window. If the budget allows the reading is returned for sending. If
+ * the budget has been exhausted the reading is shed, either dropped or
+ * added to an average of the shed readings which is sent in place of the
+ * next reading the budget allows.
+ *
+ * @param reading	The reading to send
+ * @return		The reading to send or NULL if it was shed
+ */
+Reading *ChangeFilter::applyBudget(Reading *reading)
+{
+	if (!m_budget.enabled())
+	{
+		return reading;
+	}
+	m_windowReadings++;
+	size_t size = readingSize(reading);
+	if (m_budget.consume(m_budgetBytes ? size : 1))
+	{
+		if (m_shedAction == ShedAverage && m_shedCount > 0)
+		{
+			accumulateShed(reading);
+			Reading *average = shedAverage(reading);
+			delete reading;
+			delete m_lastShed;
+			m_lastShed = NULL;
+			return average;
+		}
+		return reading;
+	}
+
+	if (m_windowShed == 0)
+	{
+		Logger::getLogger()->warn("Filter %s has exhausted the output budget, shedding readings of %s",
+				m_name.c_str(), m_asset.c_str());
+	}
+	m_windowShed++;
+	m_shedReadings++;
+	m_shedBytes += size;
+	if (m_shedAction == ShedAverage)
+	{
+		accumulateShed(reading);
+		delete m_lastShed;
+		m_lastShed = reading;
+	}
+	else
+	{
+		delete reading;
+	}
+	return NULL;
+}
+
+/**
+ * Called at the end of a triggered window to send any average of shed
+ * readings that is pending and report the readings shed in the window.
+ *
+ * @param out	The output buffer
+ */
+void ChangeFilter::endBudgetWindow(vector<Reading *>& out)
+{
+	if (m_lastShed)
+	{
+		if (m_shedCount > 0)
+		{
+			Reading *average = shedAverage(m_lastShed);
+			m_budget.charge(m_budgetBytes ? readingSize(average) : 1);
+			out.push_back(average);
+		}
+		delete m_lastShed;
+		m_lastShed = NULL;
+	}
+	if (m_windowShed)
+	{
+		Logger::getLogger()->info("Filter %s shed %lu of %lu readings of %s in the triggered window, %lu readings and %lu bytes shed in total",
+				m_name.c_str(), m_windowShed, m_windowReadings, m_asset.c_str(),
+				m_shedReadings, m_shedBytes);
+	}
+	m_windowShed = 0;
+	m_windowReadings = 0;
+}
+
+/**
+ * Estimate the number of bytes a reading will occupy once sent onwards.
+ * This is the size of the names and the values it contains.
+ *
+ * @param reading	The reading to size
+ */
+size_t ChangeFilter::readingSize(Reading *reading)
+{
+size_t	size = reading->getAssetName().size() + sizeof(struct timeval) * 2;
+
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
+	{
+		DatapointValue& data = (*it)->getData();
+		size += (*it)->getName().size();
+		switch (data.getType())
+		{
+			case DatapointValue::T_STRING:
+				size += data.toString().size();
+				break;
+			case DatapointValue::T_FLOAT_ARRAY:
+				size += data.getDpArr()->size() * sizeof(double);
+				break;
+			case DatapointValue::T_2D_FLOAT_ARRAY:
+			{
+				vector<vector<double>* > *rows = data.getDp2DArr();
+				for (auto row = rows->cbegin(); row != rows->cend(); ++row)
+				{
+					size += (*row)->size() * sizeof(double);
+				}
+				break;
+			}
+			case DatapointValue::T_DP_LIST:
+			case DatapointValue::T_DP_DICT:
+				size += data.getDpVec()->size() * sizeof(double);
+				break;
+			default:
+				size += sizeof(double);
+				break;
+		}
+	}
+	return size;
+}
+
+/**
+ * Accumulate the numeric and array datapoints of a reading into the
+ * average data.
+ *
+ * @param reading	The reading to add
+ */
+void ChangeFilter::accumulateAverage(Reading *reading)
+{
+	reading->getUserTimestamp(&m_averageUserTs);
+	reading->getTimestamp(&m_averageTs);
+	accumulate(reading, m_averageMap, m_arrayAverageMap, true);
+	m_averageCount++;
+}
+
+/**
+ * Accumulate the numeric and array datapoints of a reading shed by the
+ * output budget. These are kept apart from the average data of the
+ * untriggered state so that shedding neither disturbs the average being
+ * built nor the quantile estimators.
+ *
+ * @param reading	The reading shed
+ */
+void ChangeFilter::accumulateShed(Reading *reading)
+{
+	accumulate(reading, m_shedMap, m_shedArrayMap, false);
+	m_shedCount++;
+}
+
+/**
+ * Accumulate the numeric and array datapoints of a reading into a set of
+ * sums.
+ *
+ * @param reading	The reading to add
+ * @param sums		The sums of the numeric datapoints
+ * @param arrays	The sums of the array datapoints
+ * @param quantiles	Also add the numeric values to the quantile estimators
+ */
+void ChangeFilter::accumulate(Reading *reading, map<string, double>& sums,
+		map<string, ArrayAverage>& arrays, bool quantiles)
+{
+	vector<Datapoint *>	datapoints = reading->getReadingData();
+	for (auto it = datapoints.begin(); it != datapoints.end(); it++)
+	{
+		DatapointValue& dpvalue = (*it)->getData();
+		if (dpvalue.getType() == DatapointValue::T_INTEGER)
+		{
+			addDataPoint(sums, (*it)->getName(), (double)dpvalue.toInt(), quantiles);
+		}
+		if (dpvalue.getType() == DatapointValue::T_FLOAT)
+		{
+			addDataPoint(sums, (*it)->getName(), dpvalue.toDouble(), quantiles);
+		}
+		if (dpvalue.getType() == DatapointValue::T_FLOAT_ARRAY)
+		{
+			addArrayDataPoint(arrays, (*it)->getName(), *dpvalue.getDpArr(), 0);
+		}
+		if (dpvalue.getType() == DatapointValue::T_2D_FLOAT_ARRAY)
+		{
+			// Flatten the rows, ragged arrays can not be averaged
+			vector<vector<double>* > *rows = dpvalue.getDp2DArr();
+			size_t width = rows->empty() ? 0 : rows->front()->size();
+			bool ragged = false;
+			m_flatten.clear();
+			for (auto row = rows->begin(); row != rows->end(); row++)
+			{
+				if ((*row)->size() != width)
+				{
+					ragged = true;
+					break;
+				}
+				m_flatten.insert(m_flatten.end(), (*row)->begin(), (*row)->end());
+			}
+			if (!ragged)
+			{
+				addArrayDataPoint(arrays, (*it)->getName(), m_flatten, rows->size());
+			}
+		}
+	}
+}
+
+/**
+ * Add a reading to the average data. If the period has enxpired in which
+ * to send a reading then the average will be calculated and added to the
+ * out buffer.
+ *
+ * @param reading	The reading to add
+ * @param out		The output buffer to add any average to.
+ */
+void ChangeFilter::addAverageReading(Reading *reading, vector<Reading *>& out)
+{
+	accumulateAverage(reading);
+	if (m_adaptiveRate && m_lastValueValid)
+	{
+		// Welford's running variance of the trigger datapoint
+		m_activityCount++;
+		double delta = m_lastValue - m_activityMean;
+		m_activityMean += delta / m_activityCount;
+		m_activityM2 += delta * (m_lastValue - m_activityMean);
+	}
+
+	struct timeval t1, res;
+	reading->getUserTimestamp(&t1);
+	if (!timerisset(&m_lastSent))
+	{
+		// The first period starts with the first reading
+		m_lastSent = t1;
+		m_periodStart = chrono::steady_clock::now();
+	}
+	else
+	{
+		timeradd(&m_lastSent, &m_interval, &res);
+		if (timercmp(&t1, &res, >))
+		{
+			record(RecordAverage, reading, m_averageCount, NAN);
+			Reading *average = averageReading(reading);
+			if (average->getDatapointCount() > 0)
+			{
+				out.push_back(average);
+			}
+			else
+			{
+				delete average;
+			}
+			adaptInterval();
+			m_lastSent = t1;
+			m_periodStart = chrono::steady_clock::now();
+		}
+	}
+	if (m_idleFlush && !m_flushScheduled && m_averageCount > 0)
+	{
+		scheduleFlush();
+	}
+}
+
+/**
+ * Choose the length of the next reduced rate period from the activity of
+ * the trigger datapoint in the period just ended. The standard deviation
+ * of the trigger datapoint is scaled linearly from the maximum interval,
+ * for a flat signal, to the minimum interval when it reaches the activity
+ * scale.
+ */
+void ChangeFilter::adaptInterval()
+{
+	if (!m_adaptiveRate)
+	{
+		return;
+	}
+	double deviation = 0.0;
+	if (m_activityCount > 1)
+	{
+		deviation = sqrt(m_activityM2 / (m_activityCount - 1));
+	}
+	double fraction = 1.0;
+	if (m_activityScale > 0.0 && deviation < m_activityScale)
+	{
+		fraction = deviation / m_activityScale;
+	}
+	long interval = m_maximumInterval - (long)((m_maximumInterval - m_minimumInterval) * fraction);
+	m_interval.tv_sec = interval / 1000;
+	m_interval.tv_usec = (interval % 1000) * 1000;
+	m_activityCount = 0;
+	m_activityMean = 0.0;
+	m_activityM2 = 0.0;
+}
+
+/**
+ * Add a reading to an average period that is aligned to the clock. The
+ * periods are fixed buckets of the reduced rate, starting at multiples
+ * of the rate from the epoch plus the alignment offset. When a reading
+ * falls in a later bucket the current bucket is sent, with the start of
+ * the bucket as its timestamp and the number of readings averaged, and
+ * any empty buckets in between are handled as configured.
+ *
+ * Readings that arrive late, for a bucket that has already been sent,
+ * are added to the next bucket.
+ *
+ * @param reading	The reading to add
+ * @param out		The output buffer to add any average to
+ */
+void ChangeFilter::addAlignedReading(Reading *reading, vector<Reading *>& out)
+{
+struct timeval	tm, now;
+
+	reading->getUserTimestamp(&tm);
+	int64_t period = m_rate.tv_sec * 1000000LL + m_rate.tv_usec;
+	int64_t offset = m_alignmentOffset * 1000000LL;
+	int64_t bucket = tm.tv_sec * 1000000LL + tm.tv_usec - offset;
+	bucket -= ((bucket % period) + period) % period;
+	bucket += offset;
+
+	if (m_bucketOpen && bucket > m_bucketStart)
+	{
+		emitBucket(out);
+	}
+	if (!m_bucketOpen)
+	{
+		if (m_lastBucketValid)
+		{
+			if (bucket <= m_lastBucket)
+			{
+				bucket = m_lastBucket + period;
+			}
+			fillGaps(bucket, out);
+		}
+		m_bucketStart = bucket;
+		m_bucketOpen = true;
+		// Map the start of the bucket onto the clock used by the flush scheduler
+		gettimeofday(&now, NULL);
+		m_periodStart = chrono::steady_clock::now()
+			- chrono::microseconds(now.tv_sec * 1000000LL + now.tv_usec - bucket);
+	}
+	accumulateAverage(reading);
+	if (m_idleFlush && !m_flushScheduled)
+	{
+		scheduleFlush();
+	}
+}
+
+/**
+ * Send the average of the current aligned bucket. The average carries
+ * the start of the bucket as its user timestamp and a sampleCount
+ * datapoint with the number of readings averaged.
+ *
+ * @param out	The output buffer to add the average to
+ */
+void ChangeFilter::emitBucket(vector<Reading *>& out)
+{
+struct timeval	start;
+
+	start.tv_sec = m_bucketStart / 1000000;
+	start.tv_usec = m_bucketStart % 1000000;
+	long count = m_averageCount;
+	Reading *average = averageReading(start, m_averageTs);
+	DatapointValue dpv(count);
+	average->addDatapoint(new Datapoint("sampleCount", dpv));
+	m_allocatedDatapoints++;
+	if (m_gapHandling == GapRepeat)
+	{
+		delete m_lastAverage;
+		m_lastAverage = new Reading(*average);
+		countAllocation(m_lastAverage);
+	}
+	out.push_back(average);
+	m_lastBucket = m_bucketStart;
+	m_lastBucketValid = true;
+	m_bucketOpen = false;
+}
+
+/**
+ * Handle the empty buckets between the last bucket sent and the bucket
+ * that is about to be opened. Empty buckets are either omitted, sent as
+ * a repeat of the last average or sent with no data. In each case the
+ * sampleCount of an empty bucket is zero.
+ *
+ * @param upTo	The start of the bucket being opened
+ * @param out	The output buffer to add empty buckets to
+ */
+void ChangeFilter::fillGaps(int64_t upTo, vector<Reading *>& out)
+{
+struct timeval	now, start;
+
+	if (m_gapHandling == GapOmit)
+	{
+		return;
+	}
+	gettimeofday(&now, NULL);
+	int64_t period = m_rate.tv_sec * 1000000LL + m_rate.tv_usec;
+	int count = 0;
+	for (int64_t bucket = m_lastBucket + period; bucket < upTo; bucket += period)
+	{
+		if (++count > MAX_GAP_BUCKETS)
+		{
+			Logger::getLogger()->warn("Filter %s has more than %d empty periods for asset %s, the remainder will be omitted",
+					m_name.c_str(), MAX_GAP_BUCKETS, m_asset.c_str());
+			break;
+		}
+		Reading *gap;
+		if (m_gapHandling == GapRepeat && m_lastAverage)
+		{
+			gap = new Reading(*m_lastAverage);
+			countAllocation(gap);
+			Datapoint *samples = gap->getDatapoint("sampleCount");
+			if (samples)
+			{
+				samples->getData().setValue((long)0);
+			}
+		}
+		else
+		{
+			DatapointValue dpv((long)0);
+			gap = new Reading(m_asset, new Datapoint("sampleCount", dpv));
+			countAllocation(gap);
+		}
+		start.tv_sec = bucket / 1000000;
+		start.tv_usec = bucket % 1000000;
+		gap->setUserTimestamp(start);
+		gap->setTimestamp(now);
+		out.push_back(gap);
+	}
+}
+
+/**
+ * Schedule a flush of the average data at the end of the current period
+ * with the shared flush scheduler.
+ */
+void ChangeFilter::scheduleFlush()
+{
+	m_flushScheduled = true;
+	m_schedulerUsed = true;
+	FlushScheduler::getInstance()->schedule(this, m_periodStart
+			+ chrono::seconds(m_interval.tv_sec) + chrono::microseconds(m_interval.tv_usec));
+}
+
+/**
+ * Called by the flush scheduler at the end of an average period. If no
+ * reading has arrived to complete the period then the pending average is
+ * sent onwards directly and the next period starts with the next reading.
+ * The average is sent after the configuration mutex has been released.
+ */
+void ChangeFilter::idleFlush()
+{
+vector<Reading *>	out;
+
+	{
+		lock_guard<mutex> guard(m_configMutex);
+		m_flushScheduled = false;
+		if (!m_idleFlush || m_state || m_averageCount == 0
+				|| (m_rate.tv_sec == 0 && m_rate.tv_usec == 0))
+		{
+			return;
+		}
+		FlushScheduler::TimePoint due = m_periodStart
+			+ chrono::seconds(m_interval.tv_sec) + chrono::microseconds(m_interval.tv_usec);
+		if (chrono::steady_clock::now() < due)
+		{
+			// The period was restarted by a reading since the flush was scheduled
+			scheduleFlush();
+			return;
+		}
+		Logger::getLogger()->debug("Filter %s sending average for idle asset %s",
+				m_name.c_str(), m_asset.c_str());
+		if (m_alignPeriods)
+		{
+			if (m_bucketOpen)
+			{
+				emitBucket(out);
+			}
+		}
+		else
+		{
+			m_record->record(RecordAverage, m_recordAsset, m_averageUserTs, m_state,
+					m_averageCount, NAN, m_buffer.size());
+			Reading *average = averageReading(m_averageUserTs, m_averageTs);
+			if (average->getDatapointCount() > 0)
+			{
+				out.push_back(average);
+			}
+			else
+			{
+				delete average;
+			}
+			adaptInterval();
+			timerclear(&m_lastSent);
+		}
+	}
+	if (!out.empty())
+	{
+		output(new ReadingSet(&out));
+	}
+}
+
+/**
+ * Send a set of readings onwards. If coalescing is enabled the readings
+ * are held until enough have been collected, otherwise empty sets may be
+ * suppressed. The filter of an asset matched by a pattern sends via the
+ * filter that created it.
+ *
+ * @param readingSet	The readings to send
+ */
+void ChangeFilter::output(ReadingSet *readingSet)
+{
+	if (m_parent)
+	{
+		m_parent->output(readingSet);
+		return;
+	}
+	lock_guard<mutex> guard(m_coalesceMutex);
+	bool coalescing = m_coalesceReadings > 0 || m_coalesceTime > 0;
+	if (coalescing || !m_coalesced.empty())
+	{
+		// Readings held when coalescing was disabled are sent now
+		readingSet = coalesce(readingSet, !coalescing);
+		if (!readingSet)
+		{
+			return;
+		}
+	}
+	else if (m_suppressEmpty && readingSet->getAllReadings().empty())
+	{
+		delete readingSet;
+		return;
+	}
+	send(readingSet);
+}
+
+/**
+ * Pass a set of readings onwards unaltered while the filter is disabled.
+ * Any output still held for coalescing is sent ahead of the readings in
+ * the same set, and the readings are queued behind any output waiting to
+ * be delivered, so that they follow the output of the filter in order.
+ *
+ * @param readingSet	The readings to send
+ */
+void ChangeFilter::passThrough(ReadingSet *readingSet)
+{
+	lock_guard<mutex> guard(m_coalesceMutex);
+	if (!m_coalesced.empty())
+	{
+		readingSet = coalesce(readingSet, true);
+	}
+	send(readingSet);
+}
+
+/**
+ * Add a set of readings to the output held for coalescing. The held
+ * output is returned as a single set once it reaches the configured
+ * number of readings or has been held for the configured time. If
+ * neither is reached a flush is scheduled for the time at which the
+ * output becomes due. Called with the coalesce mutex held.
+ *
+ * @param readingSet	The readings to add, the set is deleted
+ * @param force		Return any held output regardless of the limits
+ * @return		The readings to send or NULL if none are to be sent
+ */
+ReadingSet *ChangeFilter::coalesce(ReadingSet *readingSet, bool force)
+{
+	vector<Reading *> *readings = readingSet->getAllReadingsPtr();
+	FlushScheduler::TimePoint now = chrono::steady_clock::now();
+	if (m_coalesced.empty())
+	{
+		m_coalesceStart = now;
+	}
+	for (auto reading : *readings)
+	{
+		m_coalesced.push_back(reading);
+		m_coalescedBytes += readingBytes(reading);
+	}
+	readings->clear();
+	delete readingSet;
+	if (m_coalesced.empty())
+	{
+		return NULL;
+	}
+	FlushScheduler::TimePoint due = m_coalesceStart + chrono::milliseconds(m_coalesceTime);
+	if (force || (m_coalesceReadings > 0 && m_coalesced.size() >= m_coalesceReadings)
+			|| (m_coalesceTime > 0 && now >= due)
+			|| (m_memoryLimit > 0 && m_memoryUsed + m_coalescedBytes > m_memoryLimit))
+	{
+		ReadingSet *coalesced = new ReadingSet(&m_coalesced);
+		m_coalesced.clear();
+		m_coalescedBytes = 0;
+		return coalesced;
+	}
+	if (m_coalesceTime > 0 && !m_coalesceScheduled)
+	{
+		m_coalesceScheduled = true;
+		m_schedulerUsed = true;
+		FlushScheduler::getInstance()->schedule(this, due, FlushOutput);
+	}
+	return NULL;
+}
+
+/**
+ * Called by the flush scheduler when coalesced output has been held for
+ * the configured time without further output arriving to send it.
+ */
+void ChangeFilter::flushOutput()
+{
+	lock_guard<mutex> guard(m_coalesceMutex);
+	m_coalesceScheduled = false;
+	if (m_coalesced.empty())
+	{
+		return;
+	}
+	FlushScheduler::TimePoint due = m_coalesceStart + chrono::milliseconds(m_coalesceTime);
+	if (m_coalesceTime > 0 && chrono::steady_clock::now() < due)
+	{
+		// The held output was sent and restarted since the flush was scheduled
+		m_coalesceScheduled = true;
+		FlushScheduler::getInstance()->schedule(this, due, FlushOutput);
+		return;
+	}
+	send(new ReadingSet(&m_coalesced));
+	m_coalesced.clear();
+	m_coalescedBytes = 0;
+}
+
+/**
+ * Pass a set of readings to the next stage. If the asynchronous output
+ * stage is enabled the readings are queued for delivery by the output
+ * thread, otherwise they are delivered on the calling thread.
+ *
+ * @param readingSet	The readings to send
+ */
+void ChangeFilter::send(ReadingSet *readingSet)
+{
+	// The idle flush may also produce and a reconfigure may replace the
+	// output stage, serialise the producer side
+	lock_guard<mutex> guard(m_producerMutex);
+	if (m_outputQueue)
+	{
+		m_outputQueue->push(readingSet);
+	}
+	else
+	{
+		deliver(readingSet);
+	}
+}
+
+/**
+ * Start the asynchronous output stage, a bounded queue and a thread that
+ * delivers the queued readings onwards in the order they were queued.
+ * Called with the producer mutex held. The queue mutex only guards the
+ * queue pointer for the monitoring calls, which must not wait behind a
+ * producer that is blocked on a full queue.
+ *
+ * @param depth	The number of reading sets the queue may hold
+ */
+void ChangeFilter::startOutputThread(size_t depth)
+{
+	OutputQueue *queue = new OutputQueue(depth);
+	{
+		lock_guard<mutex> guard(m_queueMutex);
+		m_outputQueue = queue;
+	}
+	m_outputThread = new thread([this, queue] {
+		ReadingSet *readingSet;
+		while ((readingSet = queue->pop()) != NULL)
+		{
+			deliver(readingSet);
+		}
+	});
+}
+
+/**
+ * Stop the asynchronous output stage, the readings already queued are
+ * delivered before the thread exits. Called with the producer mutex held.
+ */
+void ChangeFilter::stopOutputThread()
+{
+	if (!m_outputQueue)
+	{
+		return;
+	}
+	m_outputQueue->close();
+	m_outputThread->join();
+	Logger::getLogger()->info("Filter %s output queue waited %lu uS for space",
+			m_name.c_str(), m_outputQueue->waitTime());
+	OutputQueue *queue = m_outputQueue;
+	{
+		lock_guard<mutex> guard(m_queueMutex);
+		m_outputQueue = NULL;
+	}
+	delete m_outputThread;
+	delete queue;
+	m_outputThread = NULL;
+}
+
+/**
+ * Deliver a set of readings onwards, adding the asset tracking tuples for
+ * the readings sent. This serialises the output of the filter with any
+ * data sent by the flush scheduler or sent early on a trigger.
+ *
+ * @param readingSet	The readings to send
+ */
+void ChangeFilter::deliver(ReadingSet *readingSet)
+{
+	lock_guard<mutex> guard(m_outputMutex);
+	AssetTracker *assetTrackerInstance = AssetTracker::getAssetTracker();
+	if (assetTrackerInstance != nullptr)
+	{
+		const vector<Reading *>& readings = readingSet->getAllReadings();
+		for (vector<Reading *>::const_iterator elem = readings.begin();
+							      elem != readings.end();
+							      ++elem)
+		{
+			assetTrackerInstance->addAssetTrackingTuple(getName(), (*elem)->getAssetName(), string("Filter"));
+		}
+	}
+	m_func(m_data, readingSet);
+}
+
+/**
+ * Send the output built so far onwards immediately rather than at the
+ * end of the batch. The remainder of the batch follows in order.
+ *
+ * @param out	The output readings, cleared once sent
+ */
+void ChangeFilter::emitEarly(vector<Reading *>& out)
+{
+	if (out.empty())
+	{
+		return;
+	}
+	ReadingSet *readingSet = new ReadingSet(&out);
+	out.clear();
+	output(readingSet);
+}
+
+/**
+ * Add a data point to a set of sums
+ *
+ * @param sums		The sums to add to
+ * @param name		The datapoint name
+ * @param value		The datapoint value
+ * @param quantiles	Also add the value to the quantile estimators
+ */
+void ChangeFilter::addDataPoint(map<string, double>& sums, const string& name,
+		double value, bool quantiles)
+{
+	map<string, double>::iterator it = sums.find(name);
+	if (it != sums.end())
+	{
+		it->second += value;
+	}
+	else
+	{
+		sums.insert(pair<string, double>(name, value));
+		m_tablesChanged = true;
+	}
+	if (quantiles && !m_quantiles.empty())
+	{
+		vector<P2Quantile>& estimators = m_quantileMap[name];
+		if (estimators.empty())
+		{
+			m_tablesChanged = true;
+			for (auto quantile : m_quantiles)
+			{
+				estimators.push_back(P2Quantile(quantile));
+			}
+		}
+		for (auto& estimator : estimators)
+		{
+			estimator.add(value);
+		}
+	}
+}
+
+/**
+ * Add an array data point to a set of element-wise sums. If the shape
+ * of the array differs from that being accumulated then the accumulation
+ * restarts with the new shape.
+ *
+ * @param arrays	The sums to add to
+ * @param name		The datapoint name
+ * @param values	The array values, flattened if two dimensional
+ * @param rows		The number of rows or zero for a one dimensional array
+ */
+void ChangeFilter::addArrayDataPoint(map<string, ArrayAverage>& arrays, const string& name,
+		const vector<double>& values, size_t rows)
+{
+	ArrayAverage& average = arrays[name];
+	if (average.m_count == 0 || average.m_rows != rows
+			|| average.m_sum.size() != values.size())
+	{
+		if (average.m_count)
+		{
+			Logger::getLogger()->debug("Shape of array datapoint %s has changed, restarting average",
+					name.c_str());
+		}
+		average.m_sum.assign(values.size(), 0.0);
+		average.m_rows = rows;
+		average.m_count = 0;
+		m_tablesChanged = true;
+	}
+	addArray(average.m_sum.data(), values.data(), values.size());
+	average.m_count++;
+}
+
+/**
+ * Create a average reading using the asset name and times from the reading
+ * passed in and the data accumulated in the average map
+ *
+ * @param reading	The reading to take the asset name and times from
+ */
+Reading *ChangeFilter::averageReading(Reading *templateReading)
+{
+struct timeval	userTs, ts;
+
+	templateReading->getUserTimestamp(&userTs);
+	templateReading->getTimestamp(&ts);
+	return averageReading(userTs, ts);
+}
+
+/**
+ * Create a average reading for the asset with the times given and the
+ * data accumulated in the average map
+ *
+ * @param userTs	The user timestamp of the average
+ * @param ts		The timestamp of the average
+ */
+Reading *ChangeFilter::averageReading(const struct timeval& userTs, const struct timeval& ts)
+{
+vector<Datapoint *>	datapoints;
+
+	CHANGE_TRACE3(average, m_asset.c_str(), m_averageCount,
+			m_averageMap.size() + m_arrayAverageMap.size());
+	datapoints.reserve(m_averageMap.size() + m_arrayAverageMap.size());
+	for (map<string, double>::iterator it = m_averageMap.begin();
+				it != m_averageMap.end(); it++)
+	{
+		DatapointValue dpv(it->second / m_averageCount);
+		it->second = 0.0;
+		datapoints.push_back(new Datapoint(it->first, dpv));
+		if (!m_quantiles.empty())
+		{
+			vector<P2Quantile>& estimators = m_quantileMap[it->first];
+			for (size_t i = 0; i < estimators.size(); i++)
+			{
+				if (estimators[i].count() > 0)
+				{
+					DatapointValue quantile(estimators[i].value());
+					datapoints.push_back(new Datapoint(it->first + m_quantileSuffixes[i], quantile));
+				}
+				estimators[i].reset();
+			}
+		}
+	}
+	m_averageCount = 0;
+	addArrayAverages(m_arrayAverageMap, datapoints);
+	Reading	*rval = new Reading(m_asset, datapoints);
+	countAllocation(rval);
+	rval->setUserTimestamp(userTs);
+	rval->setTimestamp(ts);
+	return rval;
+}
+
+/**
+ * Create a reading of the average of the readings shed by the output
+ * budget, using the asset name and times from the reading passed in.
+ * Only the averages are sent, the quantiles describe the reduced rate
+ * data of the untriggered state and are not affected by shedding.
+ *
+ * @param templateReading	The reading to take the times from
+ */
+Reading *ChangeFilter::shedAverage(Reading *templateReading)
+{
+vector<Datapoint *>	datapoints;
+struct timeval		userTs, ts;
+
+	CHANGE_TRACE3(average, m_asset.c_str(), m_shedCount,
+			m_shedMap.size() + m_shedArrayMap.size());
+	datapoints.reserve(m_shedMap.size() + m_shedArrayMap.size());
+	for (map<string, double>::iterator it = m_shedMap.begin();
+				it != m_shedMap.end(); it++)
+	{
+		DatapointValue dpv(it->second / m_shedCount);
+		it->second = 0.0;
+		datapoints.push_back(new Datapoint(it->first, dpv));
+	}
+	m_shedCount = 0;
+	addArrayAverages(m_shedArrayMap, datapoints);
+	templateReading->getUserTimestamp(&userTs);
+	templateReading->getTimestamp(&ts);
+	Reading	*rval = new Reading(m_asset, datapoints);
+	countAllocation(rval);
+	rval->setUserTimestamp(userTs);
+	rval->setTimestamp(ts);
+	return rval;
+}
+
+/**
+ * Add a datapoint for each of a set of element-wise array sums that holds
+ * the average of the arrays accumulated, and restart the sums.
+ *
+ * @param arrays	The array sums
+ * @param datapoints	The datapoints to add to
+ */
+void ChangeFilter::addArrayAverages(map<string, ArrayAverage>& arrays, vector<Datapoint *>& datapoints)
+{
+	for (map<string, ArrayAverage>::iterator it = arrays.begin();
+				it != arrays.end(); it++)
+	{
+		ArrayAverage& average = it->second;
+		if (average.m_count == 0)
+		{
+			continue;
+		}
+		for (size_t i = 0; i < average.m_sum.size(); i++)
+		{
+			average.m_sum[i] /= average.m_count;
+		}
+		if (average.m_rows == 0)
+		{
+			DatapointValue dpv(average.m_sum);
+			datapoints.push_back(new Datapoint(it->first, dpv));
+		}
+		else
+		{
+			vector<vector<double>* > *arr2d = new vector<vector<double>* >;
+			size_t width = average.m_sum.size() / average.m_rows;
+			for (size_t row = 0; row < average.m_rows; row++)
+			{
+				arr2d->push_back(new vector<double>(average.m_sum.begin() + row * width,
+						average.m_sum.begin() + (row + 1) * width));
+			}
+			DatapointValue dpv(arr2d);
+			datapoints.push_back(new Datapoint(it->first, dpv));
+		}
+		average.m_count = 0;
+	}
+}
+
+/**
+ * Add a record of a decision to the flight recorder
+ *
+ * @param event		The decision made
+ * @param reading	The reading that caused the decision
+ * @param value		The value of the decision, NAN if there is none
+ * @param previous	The previous value, NAN if there is none
+ */
+void ChangeFilter::record(RecordEvent event, Reading *reading, double value, double previous)
+{
+	struct timeval tm;
+	reading->getUserTimestamp(&tm);
+	m_record->record(event, m_recordAsset, tm, m_state, value, previous, m_buffer.size());
+}
+
+/**
+ * Write the decisions held by the flight recorder to a file
+ *
+ * @param path	The file to write
+ * @return	True if the file was written
+ */
+bool ChangeFilter::dumpRecorder(const string& path)
+{
+	if (!m_record->dump(path))
+	{
+		Logger::getLogger()->error("Filter %s is unable to write the flight recorder to %s",
+				m_name.c_str(), path.c_str());
+		return false;
+	}
+	Logger::getLogger()->info("Filter %s wrote the flight recorder to %s",
+			m_name.c_str(), path.c_str());
+	return true;
+}
+
+/**
+ * The file the flight recorder is written to on demand when no file has
+ * been configured. This is in the Fledge data directory, or /tmp if that
+ * is not known, and is named after the filter with any characters that
+ * are not safe in a file name replaced.
+ *
+ * @return	The path of the file
+ */
+string ChangeFilter::defaultRecorderFile() const
+{
+	string dir = "/tmp";
+	const char *data = getenv("FLEDGE_DATA");
+	const char *root = getenv("FLEDGE_ROOT");
+	if (data && *data)
+	{
+		dir = data;
+	}
+	else if (root && *root)
+	{
+		dir = string(root) + "/data";
+	}
+	string name = m_name;
+	for (auto& c : name)
+	{
+		if (!isalnum((unsigned char)c) && c != '-' && c != '_')
+		{
+			c = '_';
+		}
+	}
+	return dir + "/" + name + "_recorder.csv";
+}
+
+/**
+ * Return the heap used by the filter, including the filters of any assets
+ * matched by a pattern
+ *
+ * @return	The number of bytes of heap used
+ */
+size_t ChangeFilter::getFootprint()
+{
+	lock_guard<mutex> guard(m_configMutex);
+	size_t bytes = memoryUsage() + m_coalescedBytes;
+	for (auto& matched : m_matched)
+	{
+		if (matched.second.m_filter)
+		{
+			bytes += matched.second.m_filter->getFootprint();
+		}
+	}
+	return bytes;
+}
+
+/**
+ * The heap used by this filter. The readings held are accounted for as
+ * they are added and removed, the tables are only walked when they have
+ * grown. Output held for coalescing is not included, it is on its way
+ * out of the filter and may be released by another thread at any time.
+ *
+ * @return	The number of bytes of heap used
+ */
+size_t ChangeFilter::memoryUsage()
+{
+	size_t bytes = heapBytes(sizeof(ChangeFilter)) + m_configBytes
+			+ m_buffer.bytes() + m_reorder.bytes() + tableBytes();
+	if (m_lastShed)
+	{
+		bytes += readingBytes(m_lastShed);
+	}
+	if (m_lastAverage)
+	{
+		bytes += readingBytes(m_lastAverage);
+	}
+	return bytes;
+}
+
+/**
+ * The heap used by the aggregates and tables of the filter. This is
+ * recalculated only when an entry has been added since it was last
+ * calculated.
+ *
+ * @return	The number of bytes of heap used
+ */
+size_t ChangeFilter::tableBytes()
+{
+	if (!m_tablesChanged)
+	{
+		return m_tableBytes;
+	}
+	// The nodes of a map carry the colour and three links of the tree,
+	// those of an unordered map a link and the cached hash
+	const size_t treeNode = sizeof(int) + 3 * sizeof(void *);
+	const size_t hashNode = 2 * sizeof(void *);
+	size_t bytes = 0;
+	for (auto& average : m_averageMap)
+	{
+		bytes += heapBytes(treeNode + sizeof(average)) + stringBytes(average.first.size());
+	}
+	for (auto& average : m_arrayAverageMap)
+	{
+		bytes += heapBytes(treeNode + sizeof(average)) + stringBytes(average.first.size())
+			+ vectorBytes(average.second.m_sum.capacity(), sizeof(double));
+	}
+	for (auto& average : m_shedMap)
+	{
+		bytes += heapBytes(treeNode + sizeof(average)) + stringBytes(average.first.size());
+	}
+	for (auto& average : m_shedArrayMap)
+	{
+		bytes += heapBytes(treeNode + sizeof(average)) + stringBytes(average.first.size())
+			+ vectorBytes(average.second.m_sum.capacity(), sizeof(double));
+	}
+	for (auto& estimators : m_quantileMap)
+	{
+		bytes += heapBytes(treeNode + sizeof(estimators)) + stringBytes(estimators.first.size())
+			+ vectorBytes(estimators.second.capacity(), sizeof(P2Quantile));
+	}
+	for (auto& deadband : m_deadbands)
+	{
+		bytes += heapBytes(treeNode + sizeof(deadband)) + stringBytes(deadband.first.size());
+	}
+	bytes += vectorBytes(m_slots.capacity(), sizeof(ExceptionSlot));
+	for (auto& slot : m_slots)
+	{
+		bytes += stringBytes(slot.m_strValue.size());
+	}
+	bytes += vectorBytes(m_slotIndex.bucket_count(), sizeof(void *));
+	for (auto& index : m_slotIndex)
+	{
+		bytes += heapBytes(hashNode + sizeof(index)) + stringBytes(index.first.size());
+	}
+	bytes += vectorBytes(m_doors.capacity(), sizeof(SwingingDoor))
+		+ vectorBytes(m_doorNames.capacity(), sizeof(string))
+		+ vectorBytes(m_doorIndex.bucket_count(), sizeof(void *));
+	for (auto& index : m_doorIndex)
+	{
+		bytes += heapBytes(hashNode + sizeof(index)) + 2 * stringBytes(index.first.size());
+	}
+	bytes += vectorBytes(m_matched.bucket_count(), sizeof(void *));
+	for (auto& matched : m_matched)
+	{
+		bytes += heapBytes(hashNode + sizeof(matched)) + stringBytes(matched.first.size())
+			+ heapBytes(3 * sizeof(void *));
+	}
+	bytes += vectorBytes(m_shards.capacity(), sizeof(AssetShard))
+		+ vectorBytes(m_sequence.capacity(), sizeof(pair<size_t, Reading *>));
+	for (auto& shard : m_shards)
+	{
+		bytes += vectorBytes(shard.m_readings.capacity(), sizeof(Reading *))
+			+ vectorBytes(shard.m_runs.capacity(), sizeof(size_t))
+			+ vectorBytes(shard.m_run.capacity(), sizeof(Reading *))
+			+ vectorBytes(shard.m_out.capacity(), sizeof(Reading *))
+			+ vectorBytes(shard.m_outRuns.capacity(), sizeof(size_t));
+	}
+	bytes += vectorBytes(m_run.capacity(), sizeof(Reading *))
+		+ vectorBytes(m_flatten.capacity(), sizeof(double))
+		+ vectorBytes(m_decimationCurve.capacity(), sizeof(pair<long, int>))
+		+ vectorBytes(m_quantiles.capacity(), sizeof(double))
+		+ vectorBytes(m_quantileSuffixes.capacity(), sizeof(string))
+		+ vectorBytes(m_coalesced.capacity(), sizeof(Reading *));
+	if (m_record == &m_recorder)
+	{
+		bytes += m_recorder.bytes();
+	}
+	m_tableBytes = bytes;
+	m_tablesChanged = false;
+	return bytes;
+}
+
+/**
+ * Keep the heap used by the filter within the memory limit. The oldest
+ * readings in the pre-trigger buffer are discarded until the filter is
+ * within the limit, reducing the pre-trigger window. A warning is logged
+ * when the limit is first reached. The filter of an asset that matched
+ * a pattern is kept within its share of the limit of the filter that
+ * created it. Output held for coalescing is not paid for by discarding
+ * pre-trigger data, it is sent early when it would exceed the limit.
+ */
+void ChangeFilter::enforceLimit()
+{
+	if (m_memoryLimit == 0)
+	{
+		return;
+	}
+	size_t limit = m_parent ? m_parent->m_assetLimit.load() : m_memoryLimit;
+	size_t used = memoryUsage();
+	if (used > limit)
+	{
+		while (!m_buffer.empty() && used > limit)
+		{
+			size_t before = m_buffer.bytes();
+			delete m_buffer.front();
+			m_buffer.pop();
+			used -= before - m_buffer.bytes();
+			m_memoryShed++;
+		}
+		if (!m_memoryBreach)
+		{
+			m_memoryBreach = true;
+			Logger::getLogger()->warn("Filter %s has reached its memory limit of %lu bytes, the pre-trigger data will be reduced",
+					m_name.c_str(), (unsigned long)limit);
+		}
+	}
+	else if (m_memoryBreach && used < limit - limit / 10)
+	{
+		m_memoryBreach = false;
+	}
+	m_memoryUsed = used;
+}
+
+/**
+ * Count the allocation of a reading, and its datapoints, by the filter
+ *
+ * @param reading	The reading that was allocated
+ */
+void ChangeFilter::countAllocation(Reading *reading)
+{
+	m_allocatedReadings++;
+	m_allocatedDatapoints += reading->getDatapointCount();
+}
+
+/**
+ * Clear the average data having triggered a change of state
+ *
+ */
+void ChangeFilter::clearAverage()
+{
+	m_averageCount = 0;
+	m_bucketOpen = false;
+	for (map<string, double>::iterator it = m_averageMap.begin();
+				it != m_averageMap.end(); it++)
+	{
+		it->second = 0.0;
+	}
+	for (map<string, ArrayAverage>::iterator it = m_arrayAverageMap.begin();
+				it != m_arrayAverageMap.end(); it++)
+	{
+		it->second.m_count = 0;
+	}
+	for (auto it = m_quantileMap.begin(); it != m_quantileMap.end(); it++)
+	{
+		for (auto& estimator : it->second)
+		{
+			estimator.reset();
+		}
+	}
+}
+
+/**
+ * Reduce an array datapoint to the single value that is monitored for
+ * change using the configured reduction. Lists contribute any numeric
+ * elements they contain.
+ *
+ * @param dpv	The datapoint value to reduce
+ * @param value	The reduced value
+ * @return	True if the datapoint is an array that could be reduced
+ */
+bool ChangeFilter::reduceArray(DatapointValue& dpv, double& value)
+{
+ArrayStats	stats;
+
+	switch (dpv.getType())
+	{
+		case DatapointValue::T_FLOAT_ARRAY:
+		{
+			vector<double> *arr = dpv.getDpArr();
+			stats.accumulate(arr->data(), arr->size());
+			break;
+		}
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			vector<vector<double>* > *rows = dpv.getDp2DArr();
+			for (auto row = rows->begin(); row != rows->end(); row++)
+			{
+				stats.accumulate((*row)->data(), (*row)->size());
+			}
+			break;
+		}
+		case DatapointValue::T_DP_LIST:
+		{
+			vector<Datapoint *> *elements = dpv.getDpVec();
+			for (auto elem = elements->begin(); elem != elements->end(); elem++)
+			{
+				DatapointValue& data = (*elem)->getData();
+				if (data.getType() == DatapointValue::T_INTEGER)
+					stats.accumulate((double)data.toInt());
+				else if (data.getType() == DatapointValue::T_FLOAT)
+					stats.accumulate(data.toDouble());
+			}
+			if (stats.count() == 0)
+			{
+				return false;
+			}
+			break;
 		}
-		offset++;
+		default:
+			return false;
 	}
-	readings->clear();
+	value = stats.reduce(m_reduction);
+	return true;
 }
 
 /**
- * If we have a preTrigger buffer defined in the configuration then
- * keep a copy of the reading in the pretrigger buffer. Remove any readings
- * that are older than the defined pretrigger age.
+ * A change has been detected in the trigger datapoint. Set the triggered
+ * state and the stop time and restart the post-trigger decimation. The
+ * stop time is relative to the timestamp of the reading that changed, as
+ * it is compared with the timestamps of the readings that follow.
  *
- * @param reading	Reading to buffer
+ * @param reading	The reading in which the change was detected
  */
-void ChangeFilter::bufferPretrigger(Reading *reading)
+void ChangeFilter::trigger(Reading *reading)
 {
-Reading	*t;
-struct timeval	now, t1, t2, res;
+struct timeval	now, post, limit;
+bool		extend = m_state;
 
-	if (m_preTrigger == 0)	// No pretrigger buffering
+	reading->getUserTimestamp(&now);
+	if (!m_state)
 	{
-		return;
+		m_windowStart = now;
+		m_triggerCount++;
+		CHANGE_TRACE3(trigger_fire, m_asset.c_str(), m_triggerCount, m_buffer.size());
 	}
-	m_buffer.push_back(new Reading(*reading));
-
-	/*
-	 * Remove the entries from the front of the pretrigger buffer taht are
-	 * older than the pre trigger time.
-	 */
-	t2.tv_sec = m_preTrigger / 1000;
-	t2.tv_usec = (m_preTrigger % 1000) * 1000;
-	for (;;)
+	m_state = true;
+	record(extend ? RecordExtend : RecordTrigger, reading,
+			m_lastValueValid ? m_lastValue : NAN,
+			m_lastValueValid ? m_prevValue : NAN);
+	post.tv_sec = m_postTrigger / 1000;
+	post.tv_usec = (m_postTrigger % 1000) * 1000;
+	timeradd(&now, &post, &m_stopTime);
+	if (m_maximumWindow > 0)
 	{
-		t = m_buffer.front();
-		t->getUserTimestamp(&t1);
-		reading->getUserTimestamp(&now);
-		timersub(&now, &t1, &res);
-		if (timercmp(&res, &t2, >))
-		{
-			t = m_buffer.front();
-			delete t;
-			m_buffer.pop_front();
-		}
-		else
+		// Changes may not extend the window beyond the maximum length
+		post.tv_sec = m_maximumWindow / 1000;
+		post.tv_usec = (m_maximumWindow % 1000) * 1000;
+		timeradd(&m_windowStart, &post, &limit);
+		if (timercmp(&m_stopTime, &limit, >))
 		{
-			break;
+			m_stopTime = limit;
+			record(RecordLimit, reading, m_maximumWindow, NAN);
 		}
 	}
+
+	reading->getUserTimestamp(&m_triggerTime);
+	timerclear(&m_lastForwarded);
+	m_decimationCount = 0;
+	m_curveIndex = 0;
 }
 
 /**
- * Send the pretigger buffer data
+ * Start the summary of a triggered window on a numeric trigger datapoint
  *
- * @param out	The output buffer
+ * @param previous	The value of the trigger datapoint before the change
+ * @param value		The value that caused the trigger
  */
-void ChangeFilter::sendPretrigger(vector<Reading *>& out)
+void ChangeFilter::openSummary(double previous, double value)
 {
-	while (!m_buffer.empty())
+	m_eventNumeric = true;
+	m_eventPrevious = previous;
+	m_eventValue = value;
+	m_eventPeak = value;
+	m_eventCount = 0;
+	timerclear(&m_eventLast);
+}
+
+/**
+ * Start the summary of a triggered window on a string trigger datapoint
+ *
+ * @param previous	The value of the trigger datapoint before the change
+ * @param value		The value that caused the trigger
+ */
+void ChangeFilter::openSummary(const string& previous, const string& value)
+{
+	m_eventNumeric = false;
+	m_eventPrevStr = previous;
+	m_eventStr = value;
+	m_eventCount = 0;
+	timerclear(&m_eventLast);
+}
+
+/**
+ * Add a reading of the asset within the triggered window to the summary.
+ * The peak is the value of the trigger datapoint that is furthest from
+ * the value before the change.
+ *
+ * @param reading	The reading within the window
+ */
+void ChangeFilter::summarise(Reading *reading)
+{
+	m_eventCount++;
+	reading->getUserTimestamp(&m_eventLast);
+	if (m_eventNumeric && m_lastValueValid
+			&& fabs(m_lastValue - m_eventPrevious) > fabs(m_eventPeak - m_eventPrevious))
 	{
-		Reading *r = m_buffer.front();
-		out.push_back(r);
-		m_buffer.pop_front();
+		m_eventPeak = m_lastValue;
 	}
 }
 
-
 /**
- * Add a reading to the average data. If the period has enxpired in which
- * to send a reading then the average will be calculated and added to the
- * out buffer.
+ * Send the summary of the triggered window that has just ended. The
+ * summary is sent as a reading of an asset named after the monitored
+ * asset with a suffix of Summary, timestamped with the time of the trigger.
  *
- * @param reading	The reading to add
- * @param out		The output buffer to add any average to.
+ * @param out	The output buffer to add the summary to
  */
-void ChangeFilter::addAverageReading(Reading *reading, vector<Reading *>& out)
+void ChangeFilter::emitSummary(vector<Reading *>& out)
 {
-	vector<Datapoint *>	datapoints = reading->getReadingData();
-	for (auto it = datapoints.begin(); it != datapoints.end(); it++)
+struct timeval	now, res;
+vector<Datapoint *>	datapoints;
+
+	if (m_eventNumeric)
 	{
-		DatapointValue& dpvalue = (*it)->getData();
-		if (dpvalue.getType() == DatapointValue::T_INTEGER)
-		{
-			addDataPoint((*it)->getName(), (double)dpvalue.toInt());
-		}
-		if (dpvalue.getType() == DatapointValue::T_FLOAT)
-		{
-			addDataPoint((*it)->getName(), dpvalue.toDouble());
-		}
+		DatapointValue previous(m_eventPrevious);
+		datapoints.push_back(new Datapoint("previous", previous));
+		DatapointValue value(m_eventValue);
+		datapoints.push_back(new Datapoint("value", value));
+		DatapointValue delta(m_eventValue - m_eventPrevious);
+		datapoints.push_back(new Datapoint("delta", delta));
+		DatapointValue peak(m_eventPeak);
+		datapoints.push_back(new Datapoint("peak", peak));
 	}
-	m_averageCount++;
-	
-	struct timeval t1, res;
-	reading->getUserTimestamp(&t1);
-	timeradd(&m_lastSent, &m_rate, &res);
-	if (timercmp(&t1, &res, >))
+	else
 	{
-		out.push_back(averageReading(reading));
-		m_lastSent = t1;
+		DatapointValue previous(m_eventPrevStr);
+		datapoints.push_back(new Datapoint("previous", previous));
+		DatapointValue value(m_eventStr);
+		datapoints.push_back(new Datapoint("value", value));
 	}
+	long duration = 0;
+	if (timerisset(&m_eventLast))
+	{
+		timersub(&m_eventLast, &m_windowStart, &res);
+		duration = res.tv_sec * 1000 + res.tv_usec / 1000;
+	}
+	DatapointValue dpvDuration(duration);
+	datapoints.push_back(new Datapoint("duration", dpvDuration));
+	DatapointValue dpvCount(m_eventCount);
+	datapoints.push_back(new Datapoint("count", dpvCount));
+
+	Reading *summary = new Reading(m_asset + "Summary", datapoints);
+	countAllocation(summary);
+	summary->setUserTimestamp(m_windowStart);
+	gettimeofday(&now, NULL);
+	summary->setTimestamp(now);
+	out.push_back(summary);
 }
 
 /**
- * Add a data point to the average data
+ * Debounce a change in the trigger datapoint. When not triggered a change
+ * is ignored during the re-arm holdoff that follows a triggered window and
+ * must persist for the minimum hold time before the filter triggers.
+ * Changes within a triggered window always extend the window.
  *
- * @param name	The datapoint name
- * @param value	The datapoint value
+ * @param reading	The reading being evaluated
+ * @param changed	True if the trigger datapoint has changed
+ * @return		True if the change should trigger the filter
  */
-void ChangeFilter::addDataPoint(const string& name, double value)
+bool ChangeFilter::debounce(Reading *reading, bool changed)
 {
-	map<string, double>::iterator it = m_averageMap.find(name);
-	if (it != m_averageMap.end())
+struct timeval	tm, res;
+
+	if (!changed)
 	{
-		it->second += value;
+		timerclear(&m_pendingSince);
+		return false;
 	}
-	else
+	if (m_state)
+	{
+		return true;
+	}
+	reading->getUserTimestamp(&tm);
+	if (timerisset(&m_rearmTime) && timercmp(&tm, &m_rearmTime, <))
+	{
+		if (!m_holdoffRecorded)
+		{
+			m_holdoffRecorded = true;
+			record(RecordHoldoff, reading, m_lastValueValid ? m_lastValue : NAN, NAN);
+		}
+		return false;
+	}
+	if (m_minimumHold > 0)
 	{
-		m_averageMap.insert(pair<string, double>(name, value));
+		if (!timerisset(&m_pendingSince))
+		{
+			m_pendingSince = tm;
+			record(RecordHold, reading, m_lastValueValid ? m_lastValue : NAN,
+					m_lastValueValid ? m_prevValue : NAN);
+			return false;
+		}
+		timersub(&tm, &m_pendingSince, &res);
+		if (res.tv_sec * 1000 + res.tv_usec / 1000 < m_minimumHold)
+		{
+			return false;
+		}
 	}
+	timerclear(&m_pendingSince);
+	return true;
 }
 
 /**
- * Create a average reading using the asset name and times from the reading
- * passed in and the data accumulated in the average map
+ * Decide if a reading of the asset within the triggered window should be
+ * forwarded or dropped by the post-trigger decimation. Readings within the
+ * full rate period that follows the change are always forwarded. This is
+ * a streaming decision, no readings are held back.
  *
- * @param reading	The reading to take the asset name and times from
+ * @param reading	The reading to consider
+ * @return		True if the reading should be forwarded
  */
-Reading *ChangeFilter::averageReading(Reading *templateReading)
+bool ChangeFilter::decimate(Reading *reading)
 {
-string			asset = templateReading->getAssetName();
-vector<Datapoint *>	datapoints;
+struct timeval	tm, res;
 
-	for (map<string, double>::iterator it = m_averageMap.begin();
-				it != m_averageMap.end(); it++)
+	if (m_decimation == DecimateNone)
 	{
-		DatapointValue dpv(it->second / m_averageCount);
-		it->second = 0.0;
-		datapoints.push_back(new Datapoint(it->first, dpv));
+		return true;
 	}
-	m_averageCount = 0;
-	Reading	*rval = new Reading(asset, datapoints);
-	struct timeval tm;
-	templateReading->getUserTimestamp(&tm);
-	rval->setUserTimestamp(tm);
-	templateReading->getTimestamp(&tm);
-	rval->setTimestamp(tm);
-	return rval;
+	reading->getUserTimestamp(&tm);
+	timersub(&tm, &m_triggerTime, &res);
+	long elapsed = res.tv_sec * 1000 + res.tv_usec / 1000;
+	if (elapsed < m_fullRatePeriod)
+	{
+		m_lastForwarded = tm;
+		m_decimationCount = 1;
+		return true;
+	}
+
+	int factor = m_decimationInterval;
+	switch (m_decimation)
+	{
+		case DecimateTime:
+			timersub(&tm, &m_lastForwarded, &res);
+			if (res.tv_sec * 1000 + res.tv_usec / 1000 >= m_decimationInterval)
+			{
+				m_lastForwarded = tm;
+				return true;
+			}
+			return false;
+		case DecimateCurve:
+			while (m_curveIndex < m_decimationCurve.size()
+					&& m_decimationCurve[m_curveIndex].first <= elapsed)
+			{
+				m_curveIndex++;
+			}
+			factor = m_curveIndex ? m_decimationCurve[m_curveIndex - 1].second : 1;
+			break;
+		default:
+			break;
+	}
+	if (factor <= 1)
+	{
+		return true;
+	}
+	bool forward = (m_decimationCount % factor) == 0;
+	m_decimationCount = (m_decimationCount + 1) % factor;
+	return forward;
 }
 
 /**
- * Clear the average data having triggered a change of state
+ * Parse the decimation curve. This is a comma separated list of pairs
+ * of the form elapsed:factor, where elapsed is the time in milliseconds
+ * since the change and factor is the 1 in N decimation to apply from
+ * that time onwards.
  *
+ * @param curve	The decimation curve to parse
  */
-void ChangeFilter::clearAverage()
+void ChangeFilter::parseDecimationCurve(const string& curve)
 {
-	for (map<string, double>::iterator it = m_averageMap.begin();
-				it != m_averageMap.end(); it++)
+	m_decimationCurve.clear();
+	const char *p = curve.c_str();
+	while (*p)
 	{
-		it->second = 0.0;
+		char *end;
+		long elapsed = strtol(p, &end, 10);
+		if (end == p || *end != ':')
+		{
+			Logger::getLogger()->error("Badly formed decimation curve '%s'", curve.c_str());
+			m_decimationCurve.clear();
+			return;
+		}
+		p = end + 1;
+		long factor = strtol(p, &end, 10);
+		if (end == p || factor < 1)
+		{
+			Logger::getLogger()->error("Badly formed decimation curve '%s'", curve.c_str());
+			m_decimationCurve.clear();
+			return;
+		}
+		if (!m_decimationCurve.empty() && elapsed <= m_decimationCurve.back().first)
+		{
+			Logger::getLogger()->error("Decimation curve '%s' must be in increasing time order", curve.c_str());
+			m_decimationCurve.clear();
+			return;
+		}
+		m_decimationCurve.push_back(pair<long, int>(elapsed, (int)factor));
+		p = end;
+		while (*p == ',' || *p == ' ')
+		{
+			p++;
+		}
 	}
 }
 
 bool ChangeFilter::evaluate(Reading *reading)
 {
-static bool firstCall = true;
 double	value;
 string  strValue;
 bool	isString = false;
 const std::vector<Datapoint *>  datapoints = reading->getReadingData();
 
+	m_lastValueValid = false;
 	for (auto itr = datapoints.cbegin(); itr != datapoints.cend(); ++itr)
 	{
 		if ((*itr)->getName().compare(m_trigger) == 0)
@@ -319,44 +2853,51 @@ const std::vector<Datapoint *>  datapoints = reading->getReadingData();
 				strValue = (*itr)->getData().toString();
 				isString = true;
 			}
-			else if (firstCall)
+			else if (!reduceArray((*itr)->getData(), value))
 			{
-				Logger::getLogger()->fatal(
-					"Filter %s can not monitor changes on the asset %s, datapoint %s, it is not a simple value",
-						m_name.c_str(), m_asset.c_str(), m_trigger.c_str());
+				if (m_firstCall)
+				{
+					Logger::getLogger()->fatal(
+						"Filter %s can not monitor changes on the asset %s, datapoint %s, it is not a simple value or array",
+							m_name.c_str(), m_asset.c_str(), m_trigger.c_str());
+				}
+				continue;
 			}
 			if (isString)
 			{
-				if (firstCall)
+				if (m_firstCall)
 				{
 					m_prevStrValue = strValue;
-					firstCall = false;
+					m_firstCall = false;
 				}
-				else if (strValue.compare(m_prevStrValue))
+				else if (debounce(reading, strValue.compare(m_prevStrValue) != 0))
 				{
-					// Triggered set to state and the stop time
-					m_state = true;
-					gettimeofday(&m_stopTime, NULL);
-					m_stopTime.tv_usec += ((m_postTrigger % 1000) * 1000);
-					m_stopTime.tv_sec += (m_postTrigger / 1000);
+					if (!m_state && m_summary != SummaryNone)
+					{
+						openSummary(m_prevStrValue, strValue);
+					}
+					trigger(reading);
 					m_prevStrValue = strValue;
 				}
 			}
 			else
 			{
 				double tolarance = (m_prevValue * m_change) / 100;
-				if (firstCall)
+				m_lastValue = value;
+				m_lastValueValid = true;
+				if (m_firstCall)
 				{
 					m_prevValue = value;
-					firstCall = false;
+					m_firstCall = false;
 				}
-				else if ((m_change == 0 && m_prevValue != value) || fabs(m_prevValue - value) >= tolarance)
+				else if (debounce(reading, (m_change == 0 && m_prevValue != value)
+							|| fabs(m_prevValue - value) >= tolarance))
 				{
-					// Triggered set to state and the stop time
-					m_state = true;
-					gettimeofday(&m_stopTime, NULL);
-					m_stopTime.tv_usec += ((m_postTrigger % 1000) * 1000);
-					m_stopTime.tv_sec += (m_postTrigger / 1000);
+					if (!m_state && m_summary != SummaryNone)
+					{
+						openSummary(m_prevValue, value);
+					}
+					trigger(reading);
 					m_prevValue = value;
 				}
 			}
@@ -377,6 +2918,16 @@ const std::vector<Datapoint *>  datapoints = reading->getReadingData();
 void ChangeFilter::reconfigure(const string& newConfig)
 {
 	lock_guard<mutex> guard(m_configMutex);
+	if (!m_reorder.empty())
+	{
+		// Process the readings held for reordering with the old configuration
+		vector<Reading *> out;
+		drainReorder(out);
+		if (!out.empty())
+		{
+			output(new ReadingSet(&out));
+		}
+	}
 	setConfig(newConfig);
 	handleConfig(m_config);
 	m_pendingReconfigure = true;
@@ -399,6 +2950,68 @@ void ChangeFilter::handleConfig(const ConfigCategory& config)
 	{
 		Logger::getLogger()->fatal("No configuration item named asset");
 	}
+	AssetMatch match = MatchExact;
+	if (config.itemExists("assetMatch"))
+	{
+		string type = config.getValue("assetMatch");
+		if (type.compare("wildcard") == 0)
+			match = MatchWildcard;
+		else if (type.compare("regular expression") == 0)
+			match = MatchRegex;
+	}
+	m_pattern.compile(match, m_asset);
+	clearAssetFilters();
+	m_maxAssets = 1000;
+	if (config.itemExists("maxAssets"))
+	{
+		long assets = strtol(config.getValue("maxAssets").c_str(), NULL, 10);
+		m_maxAssets = assets > 0 ? assets : 1;
+	}
+	unsigned int parallel = 0;
+	if (config.itemExists("parallelAssets") && m_pattern.type() != MatchExact)
+	{
+		long threads = strtol(config.getValue("parallelAssets").c_str(), NULL, 10);
+		parallel = threads > 1 ? threads : 0;
+	}
+	if (parallel != m_parallel)
+	{
+		delete m_pool;
+		m_pool = parallel ? new WorkerPool(parallel) : NULL;
+		m_parallel = parallel;
+	}
+
+	m_recorderFile.clear();
+	if (config.itemExists("recorderFile"))
+	{
+		m_recorderFile = config.getValue("recorderFile");
+	}
+	bool dump = false;
+	if (config.itemExists("dumpRecorder"))
+	{
+		dump = config.getValue("dumpRecorder").compare("true") == 0;
+	}
+	if (dump && !m_dumpRequested && m_recorder.enabled())
+	{
+		// Dump the decisions made with the previous configuration
+		dumpRecorder(m_recorderFile.empty() ? defaultRecorderFile() : m_recorderFile);
+	}
+	m_dumpRequested = dump;
+	if (config.itemExists("flightRecorder"))
+	{
+		long records = strtol(config.getValue("flightRecorder").c_str(), NULL, 10);
+		m_recorder.configure(records > 0 ? records : 0);
+	}
+	m_recordAsset = m_recorder.addAsset(m_asset);
+
+	m_memoryLimit = 0;
+	if (config.itemExists("memoryLimit"))
+	{
+		long limit = strtol(config.getValue("memoryLimit").c_str(), NULL, 10);
+		m_memoryLimit = limit > 0 ? limit * 1024 : 0;
+	}
+	m_memoryBreach = false;
+	m_configBytes = stringBytes(m_config.toJSON().size());
+	m_tablesChanged = true;
 	if (config.itemExists("trigger"))
 	{
 		setTrigger(config.getValue("trigger"));
@@ -423,6 +3036,16 @@ void ChangeFilter::handleConfig(const ConfigCategory& config)
 	{
 		Logger::getLogger()->fatal("No configuration item named preTrigger");
 	}
+	m_preTriggerCount = 0;
+	if (config.itemExists("preTriggerCount"))
+	{
+		m_preTriggerCount = strtol(config.getValue("preTriggerCount").c_str(), NULL, 10);
+		if (m_preTriggerCount < 0)
+		{
+			m_preTriggerCount = 0;
+		}
+	}
+	m_buffer.configure(m_preTriggerCount);
 	if (config.itemExists("postTrigger"))
 	{
 		m_postTrigger = strtol(config.getValue("postTrigger").c_str(), NULL, 10);
@@ -432,6 +3055,227 @@ void ChangeFilter::handleConfig(const ConfigCategory& config)
 		Logger::getLogger()->fatal("No configuration item named postTrigger");
 	}
 
+	if (config.itemExists("arrayReduction"))
+	{
+		m_reduction = arrayReduction(config.getValue("arrayReduction"));
+	}
+	else
+	{
+		m_reduction = ReducePeak;
+	}
+
+	m_decimation = DecimateNone;
+	if (config.itemExists("decimation"))
+	{
+		string decimation = config.getValue("decimation");
+		if (decimation.compare("by time") == 0)
+			m_decimation = DecimateTime;
+		else if (decimation.compare("by count") == 0)
+			m_decimation = DecimateCount;
+		else if (decimation.compare("curve") == 0)
+			m_decimation = DecimateCurve;
+	}
+	m_fullRatePeriod = 0;
+	if (config.itemExists("fullRatePeriod"))
+	{
+		m_fullRatePeriod = strtol(config.getValue("fullRatePeriod").c_str(), NULL, 10);
+	}
+	m_decimationInterval = 1;
+	if (config.itemExists("decimationInterval"))
+	{
+		m_decimationInterval = strtol(config.getValue("decimationInterval").c_str(), NULL, 10);
+		if (m_decimationInterval < 1)
+		{
+			m_decimationInterval = 1;
+		}
+	}
+	m_decimationCurve.clear();
+	if (config.itemExists("decimationCurve"))
+	{
+		parseDecimationCurve(config.getValue("decimationCurve"));
+	}
+	m_decimationCount = 0;
+	m_curveIndex = 0;
+
+	m_untriggeredMode = UntriggeredAverage;
+	if (config.itemExists("untriggeredMode"))
+	{
+		string mode = config.getValue("untriggeredMode");
+		if (mode.compare("report by exception") == 0)
+			m_untriggeredMode = UntriggeredException;
+		else if (mode.compare("swinging door") == 0)
+			m_untriggeredMode = UntriggeredSwingingDoor;
+	}
+	m_deadband = 0.0;
+	if (config.itemExists("deadband"))
+	{
+		m_deadband = fabs(strtod(config.getValue("deadband").c_str(), NULL));
+	}
+	m_deadbands.clear();
+	if (config.itemExists("deadbands"))
+	{
+		parseDeadbands(config.getValue("deadbands"));
+	}
+	m_slots.clear();
+	m_slotIndex.clear();
+	m_quantiles.clear();
+	m_quantileSuffixes.clear();
+	if (config.itemExists("quantiles"))
+	{
+		parseQuantiles(config.getValue("quantiles"));
+	}
+	m_quantileMap.clear();
+	m_doors.clear();
+	m_doorNames.clear();
+	m_doorIndex.clear();
+
+	m_minimumHold = 0;
+	if (config.itemExists("minimumHold"))
+	{
+		m_minimumHold = strtol(config.getValue("minimumHold").c_str(), NULL, 10);
+	}
+	m_maximumWindow = 0;
+	if (config.itemExists("maximumWindow"))
+	{
+		m_maximumWindow = strtol(config.getValue("maximumWindow").c_str(), NULL, 10);
+	}
+	m_rearmHoldoff = 0;
+	if (config.itemExists("rearmHoldoff"))
+	{
+		m_rearmHoldoff = strtol(config.getValue("rearmHoldoff").c_str(), NULL, 10);
+	}
+	timerclear(&m_pendingSince);
+	timerclear(&m_rearmTime);
+
+	long budget = 0;
+	if (config.itemExists("budget"))
+	{
+		budget = strtol(config.getValue("budget").c_str(), NULL, 10);
+	}
+	long burst = 1;
+	if (config.itemExists("budgetBurst"))
+	{
+		burst = strtol(config.getValue("budgetBurst").c_str(), NULL, 10);
+		if (burst < 1)
+		{
+			burst = 1;
+		}
+	}
+	m_budgetBytes = config.itemExists("budgetUnit")
+			&& config.getValue("budgetUnit").compare("bytes per second") == 0;
+	m_budget.configure(budget > 0 ? budget : 0, budget * burst);
+	m_shedAction = ShedDecimate;
+	if (config.itemExists("budgetAction")
+			&& config.getValue("budgetAction").compare("average") == 0)
+	{
+		m_shedAction = ShedAverage;
+	}
+
+	m_alignPeriods = false;
+	if (config.itemExists("alignPeriods"))
+	{
+		m_alignPeriods = config.getValue("alignPeriods").compare("true") == 0;
+	}
+	m_alignmentOffset = 0;
+	if (config.itemExists("alignmentOffset"))
+	{
+		m_alignmentOffset = strtol(config.getValue("alignmentOffset").c_str(), NULL, 10);
+	}
+	m_gapHandling = GapOmit;
+	if (config.itemExists("emptyPeriods"))
+	{
+		string gaps = config.getValue("emptyPeriods");
+		if (gaps.compare("repeat last") == 0)
+			m_gapHandling = GapRepeat;
+		else if (gaps.compare("no data") == 0)
+			m_gapHandling = GapNoData;
+	}
+	m_bucketOpen = false;
+	m_lastBucketValid = false;
+
+	m_earlyEmit = false;
+	if (config.itemExists("earlyEmit"))
+	{
+		m_earlyEmit = config.getValue("earlyEmit").compare("true") == 0;
+	}
+	m_emitPending = false;
+
+	bool async = false;
+	if (config.itemExists("asyncOutput"))
+	{
+		async = config.getValue("asyncOutput").compare("true") == 0;
+	}
+	long depth = 8;
+	if (config.itemExists("outputQueueDepth"))
+	{
+		depth = strtol(config.getValue("outputQueueDepth").c_str(), NULL, 10);
+		if (depth < 1)
+		{
+			depth = 1;
+		}
+	}
+	{
+		// Held output may be sent by the flush scheduler
+		lock_guard<mutex> guard(m_coalesceMutex);
+		{
+			lock_guard<mutex> producer(m_producerMutex);
+			stopOutputThread();
+			if (async)
+			{
+				startOutputThread(depth);
+			}
+		}
+
+		m_coalesceReadings = 0;
+		if (config.itemExists("coalesceReadings"))
+		{
+			long readings = strtol(config.getValue("coalesceReadings").c_str(), NULL, 10);
+			m_coalesceReadings = readings > 0 ? readings : 0;
+		}
+		m_coalesceTime = 0;
+		if (config.itemExists("coalesceTime"))
+		{
+			m_coalesceTime = strtol(config.getValue("coalesceTime").c_str(), NULL, 10);
+			if (m_coalesceTime < 0)
+			{
+				m_coalesceTime = 0;
+			}
+		}
+		m_suppressEmpty = false;
+		if (config.itemExists("suppressEmpty"))
+		{
+			m_suppressEmpty = config.getValue("suppressEmpty").compare("true") == 0;
+		}
+	}
+
+	m_summary = SummaryNone;
+	if (config.itemExists("eventSummary"))
+	{
+		string summary = config.getValue("eventSummary");
+		if (summary.compare("with data") == 0)
+			m_summary = SummaryWithData;
+		else if (summary.compare("instead of data") == 0)
+			m_summary = SummaryOnly;
+	}
+
+	long reorderWindow = 0;
+	if (config.itemExists("reorderWindow"))
+	{
+		reorderWindow = strtol(config.getValue("reorderWindow").c_str(), NULL, 10);
+	}
+	long reorderLimit = 1000;
+	if (config.itemExists("reorderLimit"))
+	{
+		reorderLimit = strtol(config.getValue("reorderLimit").c_str(), NULL, 10);
+	}
+	m_reorder.configure(reorderWindow > 0 ? reorderWindow : 0, reorderLimit > 0 ? reorderLimit : 1);
+
+	m_idleFlush = false;
+	if (config.itemExists("idleFlush"))
+	{
+		m_idleFlush = config.getValue("idleFlush").compare("true") == 0;
+	}
+
 	if (config.itemExists("rate") && config.itemExists("rateUnit"))
 	{
 		int rate = strtol(config.getValue("rate").c_str(), NULL, 10);
@@ -467,6 +3311,53 @@ void ChangeFilter::handleConfig(const ConfigCategory& config)
 		Logger::getLogger()->fatal("No configuration items named rate and rateUnit");
 	}
 
+	m_adaptiveRate = false;
+	if (config.itemExists("adaptiveRate"))
+	{
+		m_adaptiveRate = config.getValue("adaptiveRate").compare("true") == 0;
+	}
+	m_minimumInterval = 1000;
+	if (config.itemExists("minimumInterval"))
+	{
+		m_minimumInterval = strtol(config.getValue("minimumInterval").c_str(), NULL, 10);
+	}
+	m_maximumInterval = 60000;
+	if (config.itemExists("maximumInterval"))
+	{
+		m_maximumInterval = strtol(config.getValue("maximumInterval").c_str(), NULL, 10);
+	}
+	m_activityScale = 1.0;
+	if (config.itemExists("activity"))
+	{
+		m_activityScale = strtod(config.getValue("activity").c_str(), NULL);
+	}
+	if (m_minimumInterval < 1)
+	{
+		m_minimumInterval = 1;
+	}
+	if (m_maximumInterval < m_minimumInterval)
+	{
+		Logger::getLogger()->warn("The maximum interval is less than the minimum interval, the minimum interval will be used");
+		m_maximumInterval = m_minimumInterval;
+	}
+	m_interval = m_rate;
+	if ((m_rate.tv_sec == 0 && m_rate.tv_usec == 0) || m_alignPeriods)
+	{
+		// Adaptation only applies to free running reduced rate periods
+		m_adaptiveRate = false;
+	}
+	else if (m_adaptiveRate)
+	{
+		// The first period uses the configured rate, within the limits
+		long interval = m_rate.tv_sec * 1000 + m_rate.tv_usec / 1000;
+		interval = std::min(std::max(interval, m_minimumInterval), m_maximumInterval);
+		m_interval.tv_sec = interval / 1000;
+		m_interval.tv_usec = (interval % 1000) * 1000;
+	}
+	m_activityCount = 0;
+	m_activityMean = 0.0;
+	m_activityM2 = 0.0;
+
 	if (m_asset.compare("") == 0)
 	{
 		Logger::getLogger()->warn("No value has been given for the asset to evaluate in the change filter. The filter will have no effect");
@@ -0,0 +1,227 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <flight_recorder.h>
+#include <memory_size.h>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char *eventNames[] = {
+	"trigger", "extend", "limit", "hold", "holdoff", "end",
+	"pretrigger", "average"
+};
+
+/**
+ * Construct a disabled flight recorder
+ */
+FlightRecorder::FlightRecorder() : m_mask(0), m_next(0)
+{
+}
+
+/**
+ * Allocate the space for the records. The number of records is rounded
+ * up to a power of two, zero disables the recorder. Any records already
+ * held are discarded if the size changes. This must not be called while
+ * records are being written.
+ *
+ * @param records	The number of records to keep
+ */
+void FlightRecorder::configure(size_t records)
+{
+	size_t size = 0;
+	if (records)
+	{
+		size = 1;
+		while (size < records)
+		{
+			size <<= 1;
+		}
+	}
+	if (size == m_records.size())
+	{
+		return;
+	}
+	vector<Record> resized(size);
+	m_records.swap(resized);
+	m_mask = size ? size - 1 : 0;
+	m_next.store(0, memory_order_relaxed);
+}
+
+/**
+ * Register the name of an asset that records refer to. The index of an
+ * asset that has been removed is reused once the records that may refer
+ * to it have been overwritten, or sooner if the removed assets outnumber
+ * those in use, so that the table stays in proportion to the assets in
+ * use.
+ *
+ * @param asset	The asset name
+ * @return	The index used for the asset in the records
+ */
+unsigned int FlightRecorder::addAsset(const string& asset)
+{
+	lock_guard<mutex> guard(m_assetMutex);
+	auto it = m_assetIndex.find(asset);
+	if (it != m_assetIndex.end())
+	{
+		return it->second;
+	}
+	unsigned int index;
+	if (!m_freeAssets.empty()
+		&& (m_next.load(memory_order_relaxed) - m_freeAssets.front().m_released >= m_records.size()
+			|| m_freeAssets.size() > m_assetIndex.size()))
+	{
+		index = m_freeAssets.front().m_asset;
+		m_freeAssets.pop_front();
+		m_assets[index] = asset;
+	}
+	else
+	{
+		index = m_assets.size();
+		m_assets.push_back(asset);
+	}
+	m_assetIndex[asset] = index;
+	return index;
+}
+
+/**
+ * Remove an asset that will no longer be recorded. The name is kept for
+ * the records that refer to it until the index is reused.
+ *
+ * @param asset	The index of the asset
+ */
+void FlightRecorder::removeAsset(unsigned int asset)
+{
+	lock_guard<mutex> guard(m_assetMutex);
+	if (asset >= m_assets.size())
+	{
+		return;
+	}
+	auto it = m_assetIndex.find(m_assets[asset]);
+	if (it == m_assetIndex.end() || it->second != asset)
+	{
+		return;
+	}
+	m_assetIndex.erase(it);
+	m_freeAssets.push_back(FreeAsset(asset, m_next.load(memory_order_relaxed)));
+}
+
+/**
+ * Write a record into the next slot of the ring. The sequence number of
+ * the slot is cleared while the record is written so that a concurrent
+ * dump can detect and skip it.
+ */
+void FlightRecorder::write(RecordEvent event, unsigned int asset,
+			const struct timeval& time, bool state,
+			double value, double previous, size_t depth)
+{
+	uint64_t sequence = m_next.fetch_add(1, memory_order_relaxed);
+	Record& slot = m_records[sequence & m_mask];
+	slot.m_sequence.store(0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot.m_time = (int64_t)time.tv_sec * 1000000 + time.tv_usec;
+	slot.m_value = value;
+	slot.m_previous = previous;
+	slot.m_asset = asset;
+	slot.m_depth = depth;
+	slot.m_event = event;
+	slot.m_state = state;
+	slot.m_sequence.store(sequence + 1, memory_order_release);
+}
+
+/**
+ * Write the records held to a file as text, one line per record with the
+ * oldest first. The records may continue to be written during the dump.
+ * The file is not opened if the path is a symbolic link.
+ *
+ * @param path	The file to write
+ * @return	True if the file was written
+ */
+bool FlightRecorder::dump(const string& path)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0640);
+	if (fd == -1)
+	{
+		return false;
+	}
+	FILE *fp = fdopen(fd, "w");
+	if (!fp)
+	{
+		close(fd);
+		return false;
+	}
+	vector<string> assets;
+	{
+		lock_guard<mutex> guard(m_assetMutex);
+		assets = m_assets;
+	}
+	uint64_t next = m_next.load(memory_order_acquire);
+	uint64_t first = next > m_records.size() ? next - m_records.size() : 0;
+	fprintf(fp, "sequence,time,asset,event,triggered,value,previous,depth\n");
+	for (uint64_t sequence = first; sequence < next; sequence++)
+	{
+		Record& slot = m_records[sequence & m_mask];
+		if (slot.m_sequence.load(memory_order_acquire) != sequence + 1)
+		{
+			continue;
+		}
+		int64_t time = slot.m_time;
+		double value = slot.m_value;
+		double previous = slot.m_previous;
+		uint32_t asset = slot.m_asset;
+		uint32_t depth = slot.m_depth;
+		uint16_t event = slot.m_event;
+		uint16_t state = slot.m_state;
+		atomic_thread_fence(memory_order_acquire);
+		if (slot.m_sequence.load(memory_order_relaxed) != sequence + 1)
+		{
+			continue;	// Overwritten while it was read
+		}
+		fprintf(fp, "%llu,%lld.%06lld,%s,%s,%s,%.10g,%.10g,%u\n",
+				(unsigned long long)sequence,
+				(long long)(time / 1000000), (long long)(time % 1000000),
+				asset < assets.size() ? assets[asset].c_str() : "",
+				event < sizeof(eventNames) / sizeof(eventNames[0]) ? eventNames[event] : "",
+				state ? "true" : "false", value, previous, depth);
+	}
+	fclose(fp);
+	return true;
+}
+
+/**
+ * The heap used by the records, the asset names and the index of the
+ * asset names
+ *
+ * @return	The number of bytes of heap used
+ */
+size_t FlightRecorder::bytes()
+{
+	lock_guard<mutex> guard(m_assetMutex);
+	// The nodes of an unordered map carry a link and the cached hash
+	const size_t hashNode = 2 * sizeof(void *);
+	size_t bytes = vectorBytes(m_records.size(), sizeof(Record))
+			+ vectorBytes(m_assets.capacity(), sizeof(string))
+			+ vectorBytes(m_assetIndex.bucket_count(), sizeof(void *));
+	for (auto& asset : m_assets)
+	{
+		bytes += stringBytes(asset.size());
+	}
+	for (auto& index : m_assetIndex)
+	{
+		bytes += heapBytes(hashNode + sizeof(index)) + stringBytes(index.first.size());
+	}
+	if (!m_freeAssets.empty())
+	{
+		// A deque holds its elements in blocks of 512 bytes
+		bytes += heapBytes(512) * ((m_freeAssets.size() * sizeof(FreeAsset) + 511) / 512 + 1);
+	}
+	return bytes;
+}
@@ -0,0 +1,144 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <flush_scheduler.h>
+#include <change_filter.h>
+
+using namespace std;
+
+/**
+ * Return the scheduler shared by all the filters in the process,
+ * the scheduler thread is started on first use.
+ */
+FlushScheduler *FlushScheduler::getInstance()
+{
+	static FlushScheduler instance;
+	return &instance;
+}
+
+/**
+ * Construct the scheduler and start the timer thread
+ */
+FlushScheduler::FlushScheduler() : m_running(NULL), m_shutdown(false)
+{
+	m_thread = thread(&FlushScheduler::run, this);
+}
+
+/**
+ * Stop the timer thread
+ */
+FlushScheduler::~FlushScheduler()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+	}
+	m_cv.notify_all();
+	m_thread.join();
+}
+
+/**
+ * Schedule a flush of a filter, replacing any flush of the same type
+ * already pending for that filter.
+ *
+ * @param filter	The filter to flush
+ * @param due		The time at which the flush is due
+ * @param type		The type of flush
+ */
+void FlushScheduler::schedule(ChangeFilter *filter, const TimePoint& due, FlushType type)
+{
+	lock_guard<mutex> guard(m_mutex);
+	Flush flush(filter, type);
+	auto it = m_pending.find(flush);
+	if (it != m_pending.end())
+	{
+		m_queue.erase(it->second);
+		m_pending.erase(it);
+	}
+	m_pending[flush] = m_queue.insert(pair<TimePoint, Flush>(due, flush));
+	m_cv.notify_all();
+}
+
+/**
+ * Cancel the pending flushes of a filter. If a flush of the filter is
+ * running then wait for it to complete, after this call the filter will
+ * not be called by the scheduler. The running flush may schedule another
+ * flush of the filter, so the pending flushes are removed again once it
+ * has completed.
+ *
+ * @param filter	The filter to cancel
+ */
+void FlushScheduler::cancel(ChangeFilter *filter)
+{
+	unique_lock<mutex> lock(m_mutex);
+	for (;;)
+	{
+		auto it = m_pending.lower_bound(Flush(filter, FlushAverage));
+		while (it != m_pending.end() && it->first.first == filter)
+		{
+			m_queue.erase(it->second);
+			it = m_pending.erase(it);
+		}
+		if (m_running != filter)
+		{
+			break;
+		}
+		while (m_running == filter)
+		{
+			m_cv.wait(lock);
+		}
+	}
+}
+
+/**
+ * The timer thread, wait for the earliest flush to become due and call
+ * the filter. The filter is called without the scheduler lock held so
+ * that it may schedule its next flush.
+ */
+void FlushScheduler::run()
+{
+	unique_lock<mutex> lock(m_mutex);
+	while (!m_shutdown)
+	{
+		if (m_queue.empty())
+		{
+			m_cv.wait(lock);
+			continue;
+		}
+		auto first = m_queue.begin();
+		if (first->first > chrono::steady_clock::now())
+		{
+			// The entry may be cancelled while waiting, wait on a copy
+			TimePoint due = first->first;
+			m_cv.wait_until(lock, due);
+			continue;
+		}
+		Flush flush = first->second;
+		ChangeFilter *filter = flush.first;
+		m_pending.erase(flush);
+		m_queue.erase(first);
+		m_running = filter;
+		lock.unlock();
+		if (flush.second == FlushOutput)
+		{
+			filter->flushOutput();
+		}
+		else if (flush.second == FlushReorder)
+		{
+			filter->releaseReorder();
+		}
+		else
+		{
+			filter->idleFlush();
+		}
+		lock.lock();
+		m_running = NULL;
+		m_cv.notify_all();
+	}
+}
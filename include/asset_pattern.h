@@ -0,0 +1,46 @@
+#ifndef _ASSET_PATTERN_H
+#define _ASSET_PATTERN_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <regex>
+
+/**
+ * The way in which the asset configured for the filter is matched
+ * against the asset names of the readings
+ */
+typedef enum {
+	MatchExact,
+	MatchWildcard,
+	MatchRegex
+} AssetMatch;
+
+/**
+ * A pattern of asset names, compiled once when the filter is configured.
+ * Wildcard patterns use * to match any sequence of characters and ? to
+ * match a single character, they are compiled to a regular expression.
+ */
+class AssetPattern {
+	public:
+		AssetPattern();
+		bool	compile(AssetMatch match, const std::string& pattern);
+		bool	matches(const std::string& name) const;
+		AssetMatch
+			type() const
+			{
+				return m_match;
+			};
+	private:
+		AssetMatch	m_match;
+		std::string	m_pattern;
+		std::regex	m_regex;
+};
+
+#endif
@@ -16,7 +16,142 @@
 #include <logger.h>
 #include <list>
 #include <vector>
+#include <map>
+#include <unordered_map>
 #include <mutex>
+#include <reduction.h>
+#include <token_bucket.h>
+#include <flush_scheduler.h>
+#include <output_queue.h>
+#include <reorder_buffer.h>
+#include <pretrigger_ring.h>
+#include <asset_pattern.h>
+#include <swinging_door.h>
+#include <quantile.h>
+#include <flight_recorder.h>
+#include <memory_size.h>
+#include <worker_pool.h>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * The element-wise running sum of an array datapoint that is used to
+ * create the reduced rate average of that datapoint. Two dimensional
+ * arrays are held flattened with the number of rows recorded, one
+ * dimensional arrays have a row count of zero.
+ */
+class ArrayAverage {
+	public:
+		ArrayAverage() : m_rows(0), m_count(0)
+			{
+			};
+		std::vector<double>	m_sum;
+		size_t			m_rows;
+		int			m_count;
+};
+
+/**
+ * The last value sent for a datapoint when reporting by exception, and
+ * the deadband within which changes to that value are not reported.
+ */
+class ExceptionSlot {
+	public:
+		ExceptionSlot(double deadband) : m_sent(false), m_value(0.0),
+						 m_deadband(deadband)
+			{
+			};
+		bool		m_sent;
+		double		m_value;
+		std::string	m_strValue;
+		double		m_deadband;
+};
+
+/**
+ * The handling of readings of the asset when not in the triggered state.
+ */
+typedef enum {
+	UntriggeredAverage,
+	UntriggeredException,
+	UntriggeredSwingingDoor
+} UntriggeredMode;
+
+/**
+ * The handling of empty periods when averages are aligned to the clock
+ */
+typedef enum {
+	GapOmit,
+	GapRepeat,
+	GapNoData
+} GapHandling;
+
+/**
+ * The action taken with readings that exceed the output budget
+ */
+typedef enum {
+	ShedDecimate,
+	ShedAverage
+} ShedAction;
+
+/**
+ * The decimation applied to the asset after the full rate period of
+ * a triggered window has passed.
+ */
+typedef enum {
+	DecimateNone,
+	DecimateTime,
+	DecimateCount,
+	DecimateCurve
+} Decimation;
+
+class ChangeFilter;
+
+/**
+ * The filter for an asset that matches the asset pattern, or NULL if the
+ * asset does not match, and the position of the asset in the list of
+ * assets ordered by when they were last seen
+ */
+class MatchedAsset {
+	public:
+		MatchedAsset() : m_filter(NULL), m_shard(SIZE_MAX)
+			{
+			};
+		ChangeFilter			*m_filter;
+		std::list<const std::string *>::iterator
+						m_recent;
+		size_t				m_shard;
+};
+
+/**
+ * The readings of a matched asset in a batch that is processed in
+ * parallel. The readings are passed to the filter of the asset one run
+ * of consecutive readings at a time, the end of each run in the readings
+ * and the end of the output of each run are kept so that the output may
+ * be merged back in the order in which the readings arrived.
+ */
+class AssetShard {
+	public:
+		AssetShard() : m_matched(NULL), m_merged(0)
+			{
+			};
+		MatchedAsset			*m_matched;
+		std::vector<Reading *>		m_readings;
+		std::vector<size_t>		m_runs;
+		std::vector<Reading *>		m_run;
+		std::vector<Reading *>		m_out;
+		std::vector<size_t>		m_outRuns;
+		size_t				m_merged;
+};
+
+/**
+ * The sending of a summary reading for each triggered window
+ */
+typedef enum {
+	SummaryNone,
+	SummaryWithData,
+	SummaryOnly
+} SummaryMode;
 
 /**
  * A filter used to only send information about an asset onwards when a
@@ -62,18 +197,144 @@ class ChangeFilter : public FledgeFilter {
 				m_postTrigger = posttrigger;
 			}
 		void	ingest(std::vector<Reading *> *readings, std::vector<Reading *>& out);
+		unsigned long
+			getShedReadings() const
+			{
+				return m_shedReadings;
+			};
+		unsigned long
+			getShedBytes() const
+			{
+				return m_shedBytes;
+			};
 		void	reconfigure(const std::string& newConfig);
+		void	output(ReadingSet *readingSet);
+		void	passThrough(ReadingSet *readingSet);
+		void	idleFlush();
+		void	flushOutput();
+		void	releaseReorder();
+		size_t	getQueueDepth() const
+			{
+				std::lock_guard<std::mutex> guard(m_queueMutex);
+				return m_outputQueue ? m_outputQueue->depth() : 0;
+			};
+		unsigned long
+			getQueueWaitTime() const
+			{
+				std::lock_guard<std::mutex> guard(m_queueMutex);
+				return m_outputQueue ? m_outputQueue->waitTime() : 0;
+			};
+		uint64_t
+			getLateReadings() const
+			{
+				return m_reorder.lateReadings();
+			};
+		uint64_t
+			getAllocatedReadings() const
+			{
+				return m_allocatedReadings;
+			};
+		uint64_t
+			getAllocatedDatapoints() const
+			{
+				return m_allocatedDatapoints;
+			};
+		uint64_t
+			getAdoptedReadings() const
+			{
+				return m_adoptedReadings;
+			};
+		uint64_t
+			getTriggerCount() const;
+		bool	dumpRecorder(const std::string& path);
+		std::string
+			defaultRecorderFile() const;
+		size_t	getFootprint();
+		uint64_t
+			getMemoryShed() const;
+		size_t	getMatchedAssets() const
+			{
+				return m_matched.size();
+			};
 	private:
-		void	triggeredIngest(std::vector<Reading *> *readings, std::vector<Reading *>& out);
-		void	untriggeredIngest(std::vector<Reading *> *readings, std::vector<Reading *>& out);
+		void	reorder(std::vector<Reading *> *readings);
+		void	process(std::vector<Reading *> *readings, std::vector<Reading *>& out);
+		void	scheduleRelease();
+		void	drainReorder(std::vector<Reading *>& out);
+		void	ingestMatched(std::vector<Reading *> *readings, std::vector<Reading *>& out);
+		void	ingestSharded(std::vector<Reading *> *readings, std::vector<Reading *>& out);
+		void	runShards(std::vector<Reading *>& out);
+		MatchedAsset&
+			matchAsset(const std::string& name, std::vector<Reading *>& out);
+		ChangeFilter
+			*createAssetFilter(const std::string& asset);
+		void	evictAsset();
+		void	shareLimit();
+		void	clearAssetFilters();
+		size_t	triggeredIngest(std::vector<Reading *> *readings, size_t index,
+					std::vector<Reading *>& out);
+		size_t	untriggeredIngest(std::vector<Reading *> *readings, size_t index,
+					std::vector<Reading *>& out);
 		void	sendPretrigger(std::vector<Reading *>& out);
 		void	sendPretrigger(std::vector<Reading *>& out, Reading *trigger);
-		void	bufferPretrigger(Reading *);
+		bool	bufferPretrigger(Reading *, bool adopt);
+		bool	pretriggering() const
+			{
+				return m_preTrigger > 0 || m_preTriggerCount > 0;
+			};
 		void	addAverageReading(Reading *, std::vector<Reading *>& out);
-		void	addDataPoint(const std::string&, double);
+		void	accumulateAverage(Reading *);
+		void	accumulateShed(Reading *);
+		void	accumulate(Reading *, std::map<std::string, double>&,
+				std::map<std::string, ArrayAverage>&, bool);
+		Reading	*applyBudget(Reading *);
+		void	endBudgetWindow(std::vector<Reading *>& out);
+		size_t	readingSize(Reading *);
+		void	addDataPoint(std::map<std::string, double>&, const std::string&, double, bool);
+		void	addArrayDataPoint(std::map<std::string, ArrayAverage>&, const std::string&,
+				const std::vector<double>&, size_t);
+		void	addArrayAverages(std::map<std::string, ArrayAverage>&,
+				std::vector<Datapoint *>&);
+		bool	reduceArray(DatapointValue&, double&);
+		bool	reportByException(Reading *);
+		void	resetExceptions();
+		bool	compress(Reading *, std::vector<Reading *>& out);
+		void	flushDoors(std::vector<Reading *>& out);
+		void	archivePoints(std::vector<std::pair<double, Datapoint *> >& points,
+					std::vector<Reading *>& out);
+		void	parseDeadbands(const std::string&);
+		void	parseQuantiles(const std::string&);
+		void	adaptInterval();
 		Reading *averageReading(Reading *);
+		Reading *shedAverage(Reading *);
+		void	emitEarly(std::vector<Reading *>& out);
+		void	deliver(ReadingSet *readingSet);
+		void	send(ReadingSet *readingSet);
+		ReadingSet
+			*coalesce(ReadingSet *readingSet, bool force);
+		void	startOutputThread(size_t depth);
+		void	stopOutputThread();
+		Reading *averageReading(const struct timeval&, const struct timeval&);
+		void	countAllocation(Reading *);
+		size_t	memoryUsage();
+		size_t	tableBytes();
+		void	enforceLimit();
+		void	record(RecordEvent event, Reading *reading,
+				double value, double previous);
+		void	scheduleFlush();
+		void	addAlignedReading(Reading *, std::vector<Reading *>& out);
+		void	emitBucket(std::vector<Reading *>& out);
+		void	fillGaps(int64_t, std::vector<Reading *>& out);
 		void	clearAverage();
+		void	openSummary(double previous, double value);
+		void	openSummary(const std::string& previous, const std::string& value);
+		void	summarise(Reading *);
+		void	emitSummary(std::vector<Reading *>& out);
 		bool	evaluate(Reading *);
+		void	trigger(Reading *);
+		bool	debounce(Reading *, bool);
+		bool	decimate(Reading *);
+		void	parseDecimationCurve(const std::string&);
 		void 	handleConfig(const ConfigCategory& conf);
 		const std::string	m_name;
 		std::string		m_asset;
@@ -81,18 +342,161 @@ class ChangeFilter : public FledgeFilter {
 		int			m_change;
 		int			m_preTrigger;
 		int			m_postTrigger;
+		ArrayReduction		m_reduction;
 		struct timeval		m_rate;
 		bool			m_state;
+		bool			m_firstCall;
 		double			m_prevValue;
 		std::string		m_prevStrValue;
-		std::list<Reading *>	m_buffer;
+		int			m_preTriggerCount;
+		PretriggerRing		m_buffer;
 		struct timeval		m_stopTime;
+		struct timeval		m_triggerTime;
+		long			m_minimumHold;
+		long			m_maximumWindow;
+		long			m_rearmHoldoff;
+		struct timeval		m_pendingSince;
+		struct timeval		m_windowStart;
+		struct timeval		m_rearmTime;
+		Decimation		m_decimation;
+		long			m_fullRatePeriod;
+		int			m_decimationInterval;
+		std::vector<std::pair<long, int> >
+					m_decimationCurve;
+		struct timeval		m_lastForwarded;
+		unsigned int		m_decimationCount;
+		unsigned int		m_curveIndex;
 		bool			m_pendingReconfigure;
 		std::mutex		m_configMutex;
 		int			m_averageCount;
 		std::map<std::string, double>
 					m_averageMap;
+		std::map<std::string, ArrayAverage>
+					m_arrayAverageMap;
+		std::vector<double>	m_flatten;
+		UntriggeredMode		m_untriggeredMode;
+		double			m_deadband;
+		std::map<std::string, double>
+					m_deadbands;
+		std::vector<ExceptionSlot>
+					m_slots;
+		std::unordered_map<std::string, unsigned int>
+					m_slotIndex;
+		std::vector<SwingingDoor>
+					m_doors;
+		std::vector<std::string>
+					m_doorNames;
+		std::unordered_map<std::string, unsigned int>
+					m_doorIndex;
+		std::vector<double>	m_quantiles;
+		std::vector<std::string>
+					m_quantileSuffixes;
+		std::map<std::string, std::vector<P2Quantile> >
+					m_quantileMap;
+		struct timeval		m_interval;
+		bool			m_adaptiveRate;
+		long			m_minimumInterval;
+		long			m_maximumInterval;
+		double			m_activityScale;
+		unsigned long		m_activityCount;
+		double			m_activityMean;
+		double			m_activityM2;
 		struct timeval		m_lastSent;
+		TokenBucket		m_budget;
+		bool			m_budgetBytes;
+		ShedAction		m_shedAction;
+		Reading			*m_lastShed;
+		int			m_shedCount;
+		std::map<std::string, double>
+					m_shedMap;
+		std::map<std::string, ArrayAverage>
+					m_shedArrayMap;
+		unsigned long		m_shedReadings;
+		unsigned long		m_shedBytes;
+		unsigned long		m_windowReadings;
+		unsigned long		m_windowShed;
+		bool			m_earlyEmit;
+		bool			m_emitPending;
+		bool			m_idleFlush;
+		bool			m_flushScheduled;
+		bool			m_schedulerUsed;
+		FlushScheduler::TimePoint
+					m_periodStart;
+		struct timeval		m_averageUserTs;
+		struct timeval		m_averageTs;
+		std::mutex		m_outputMutex;
+		bool			m_alignPeriods;
+		long			m_alignmentOffset;
+		GapHandling		m_gapHandling;
+		bool			m_bucketOpen;
+		int64_t			m_bucketStart;
+		bool			m_lastBucketValid;
+		int64_t			m_lastBucket;
+		Reading			*m_lastAverage;
+		OutputQueue		*m_outputQueue;
+		std::thread		*m_outputThread;
+		std::mutex		m_producerMutex;
+		mutable std::mutex	m_queueMutex;
+		size_t			m_coalesceReadings;
+		long			m_coalesceTime;
+		bool			m_suppressEmpty;
+		std::vector<Reading *>	m_coalesced;
+		FlushScheduler::TimePoint
+					m_coalesceStart;
+		bool			m_coalesceScheduled;
+		std::mutex		m_coalesceMutex;
+		ReorderBuffer		m_reorder;
+		FlushScheduler::TimePoint
+					m_reorderActivity;
+		bool			m_reorderScheduled;
+		uint64_t		m_allocatedReadings;
+		uint64_t		m_allocatedDatapoints;
+		uint64_t		m_adoptedReadings;
+		uint64_t		m_triggerCount;
+		SummaryMode		m_summary;
+		bool			m_eventNumeric;
+		double			m_eventPrevious;
+		double			m_eventValue;
+		double			m_eventPeak;
+		std::string		m_eventPrevStr;
+		std::string		m_eventStr;
+		long			m_eventCount;
+		struct timeval		m_eventLast;
+		bool			m_lastValueValid;
+		double			m_lastValue;
+		AssetPattern		m_pattern;
+		std::unordered_map<std::string, MatchedAsset>
+					m_matched;
+		std::list<const std::string *>
+					m_recent;
+		size_t			m_maxAssets;
+		std::vector<Reading *>	m_run;
+		unsigned int		m_parallel;
+		WorkerPool		*m_pool;
+		std::vector<AssetShard>	m_shards;
+		size_t			m_shardCount;
+		std::vector<std::pair<size_t, Reading *> >
+					m_sequence;
+		ChangeFilter		*m_parent;
+		FlightRecorder		m_recorder;
+		FlightRecorder		*m_record;
+		unsigned int		m_recordAsset;
+		std::string		m_recorderFile;
+		bool			m_dumpRequested;
+		bool			m_holdoffRecorded;
+		unsigned long		m_pruned;
+		unsigned long		m_evicted;
+		size_t			m_memoryLimit;
+		uint64_t		m_memoryShed;
+		bool			m_memoryBreach;
+		std::atomic<size_t>	m_memoryUsed;
+		size_t			m_assetFilters;
+		size_t			m_assetBudget;
+		std::atomic<size_t>	m_assetLimit;
+		std::atomic<size_t>	m_coalescedBytes;
+		size_t			m_tableBytes;
+		bool			m_tablesChanged;
+		size_t			m_configBytes;
 };
 
 
@@ -0,0 +1,108 @@
+#ifndef _FLIGHT_RECORDER_H
+#define _FLIGHT_RECORDER_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * The decisions made by the filter that are kept by the flight recorder
+ */
+typedef enum {
+	RecordTrigger,		// The filter triggered
+	RecordExtend,		// A change extended the triggered window
+	RecordLimit,		// The window was limited by the maximum window
+	RecordHold,		// A change is waiting for the minimum hold
+	RecordHoldoff,		// A change was ignored in the re-arm holdoff
+	RecordEnd,		// The triggered window ended
+	RecordPretrigger,	// The pre-trigger buffer was sent
+	RecordAverage		// A reduced rate average was sent
+} RecordEvent;
+
+/**
+ * A fixed size ring of compact binary records of the decisions made by
+ * the filter, cheap enough to be left running. Space for the records is
+ * allocated when the recorder is configured. Writers claim a slot with
+ * a single atomic increment and never wait, the oldest records are
+ * overwritten. The records may be dumped to a file as text, a slot that
+ * is being overwritten while it is dumped is skipped.
+ */
+class FlightRecorder {
+	public:
+		FlightRecorder();
+		void	configure(size_t records);
+		unsigned int
+			addAsset(const std::string& asset);
+		void	removeAsset(unsigned int asset);
+		void	record(RecordEvent event, unsigned int asset,
+				const struct timeval& time, bool state,
+				double value, double previous, size_t depth)
+			{
+				if (m_mask)
+				{
+					write(event, asset, time, state, value, previous, depth);
+				}
+			};
+		bool	dump(const std::string& path);
+		bool	enabled() const
+			{
+				return m_mask != 0;
+			};
+		size_t	bytes();
+		uint64_t
+			recorded() const
+			{
+				return m_next.load(std::memory_order_relaxed);
+			};
+	private:
+		class Record {
+			public:
+				Record() : m_sequence(0)
+					{
+					};
+				std::atomic<uint64_t>	m_sequence;
+				int64_t			m_time;
+				double			m_value;
+				double			m_previous;
+				uint32_t		m_asset;
+				uint32_t		m_depth;
+				uint16_t		m_event;
+				uint16_t		m_state;
+		};
+		void	write(RecordEvent event, unsigned int asset,
+				const struct timeval& time, bool state,
+				double value, double previous, size_t depth);
+		std::vector<Record>	m_records;
+		uint64_t		m_mask;
+		std::atomic<uint64_t>	m_next;
+		class FreeAsset {
+			public:
+				FreeAsset(unsigned int asset, uint64_t released) :
+					m_asset(asset), m_released(released)
+					{
+					};
+				unsigned int		m_asset;
+				uint64_t		m_released;
+		};
+		std::vector<std::string>
+					m_assets;
+		std::unordered_map<std::string, unsigned int>
+					m_assetIndex;
+		std::deque<FreeAsset>	m_freeAssets;
+		std::mutex		m_assetMutex;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _FLUSH_SCHEDULER_H
+#define _FLUSH_SCHEDULER_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+class ChangeFilter;
+
+/**
+ * The flushes a filter may schedule, the idle average, the release of
+ * coalesced output and the release of readings held for reordering
+ */
+typedef enum {
+	FlushAverage,
+	FlushOutput,
+	FlushReorder
+} FlushType;
+
+/**
+ * A single timer thread shared by all change filters in the process. Each
+ * filter may have at most one pending flush of each type, when the flush
+ * becomes due the idleFlush, flushOutput or releaseReorder method of the
+ * filter is called on the scheduler thread.
+ */
+class FlushScheduler {
+	public:
+		typedef std::chrono::steady_clock::time_point	TimePoint;
+
+		static FlushScheduler	*getInstance();
+		void	schedule(ChangeFilter *filter, const TimePoint& due,
+					FlushType type = FlushAverage);
+		void	cancel(ChangeFilter *filter);
+	private:
+		typedef std::pair<ChangeFilter *, FlushType>	Flush;
+		FlushScheduler();
+		~FlushScheduler();
+		void	run();
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+		std::multimap<TimePoint, Flush>
+					m_queue;
+		std::map<Flush, std::multimap<TimePoint, Flush>::iterator>
+					m_pending;
+		ChangeFilter		*m_running;
+		bool			m_shutdown;
+		std::thread		m_thread;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _MEMORY_SIZE_H
+#define _MEMORY_SIZE_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <string>
+
+/*
+ * Estimates of the heap memory used by the objects the filter holds.
+ * These count the allocations made for an object, rounded up to the
+ * chunk sizes of the allocator, rather than the size of the data. The
+ * chunk sizes are those of the glibc allocator, with other allocators
+ * the figures are approximate.
+ */
+size_t	heapBytes(size_t request);
+size_t	stringBytes(size_t length);
+size_t	vectorBytes(size_t capacity, size_t element);
+size_t	datapointBytes(Datapoint *datapoint);
+size_t	readingBytes(Reading *reading);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _OUTPUT_QUEUE_H
+#define _OUTPUT_QUEUE_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_set.h>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * A bounded single producer, single consumer queue of reading sets that
+ * decouples the filtering of readings from their delivery onwards. The
+ * ring indices are lock free, the mutex is only used to sleep and wake a
+ * producer that finds the queue full or a consumer that finds it empty.
+ */
+class OutputQueue {
+	public:
+		OutputQueue(size_t capacity);
+		~OutputQueue();
+		void		push(ReadingSet *readingSet);
+		ReadingSet	*pop();
+		void		close();
+		size_t		depth() const
+				{
+					return m_tail.load() - m_head.load();
+				};
+		unsigned long	waitTime() const
+				{
+					return m_waitTime.load();
+				};
+	private:
+		void		wake(std::atomic<bool>& waiting);
+		const size_t		m_capacity;
+		std::vector<ReadingSet *>
+					m_ring;
+		std::atomic<size_t>	m_head;
+		std::atomic<size_t>	m_tail;
+		std::atomic<bool>	m_producerWaiting;
+		std::atomic<bool>	m_consumerWaiting;
+		std::atomic<bool>	m_closed;
+		std::atomic<unsigned long>
+					m_waitTime;
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+};
+
+#endif
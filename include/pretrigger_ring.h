@@ -0,0 +1,65 @@
+#ifndef _PRETRIGGER_RING_H
+#define _PRETRIGGER_RING_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <vector>
+
+/**
+ * The pre-trigger buffer, a ring of reading slots. With a fixed capacity
+ * the slots are allocated once, when the buffer is configured, and adding
+ * a reading to a full ring discards the oldest reading. A capacity of
+ * zero implies no count limit, the ring then grows as required and is
+ * bounded only by the age of the readings it holds. The heap used by the
+ * readings held is maintained as they are added and removed.
+ */
+class PretriggerRing {
+	public:
+		PretriggerRing();
+		~PretriggerRing();
+		void	configure(size_t capacity);
+		bool	push(Reading *reading);
+		Reading	*front() const
+			{
+				return m_slots[m_head].m_reading;
+			};
+		void	pop();
+		void	clear();
+		bool	empty() const
+			{
+				return m_count == 0;
+			};
+		size_t	size() const
+			{
+				return m_count;
+			};
+		size_t	capacity() const
+			{
+				return m_capacity;
+			};
+		size_t	bytes() const;
+	private:
+		class Slot {
+			public:
+				Slot() : m_reading(NULL), m_bytes(0)
+					{
+					};
+				Reading	*m_reading;
+				size_t	m_bytes;
+		};
+		void	resize(size_t slots);
+		std::vector<Slot>	m_slots;
+		size_t			m_head;
+		size_t			m_count;
+		size_t			m_capacity;
+		size_t			m_bytes;
+};
+
+#endif
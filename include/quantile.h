@@ -0,0 +1,45 @@
+#ifndef _QUANTILE_H
+#define _QUANTILE_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <cstddef>
+
+/**
+ * A streaming estimate of a quantile using the P-squared algorithm of
+ * Jain and Chlamtac. Five markers are adjusted as each value is added,
+ * so the memory used and the cost of each value are constant however
+ * many values are added. The quantile is exact for fewer than five values.
+ */
+class P2Quantile {
+	public:
+		P2Quantile(double quantile);
+		void	add(double value);
+		double	value() const;
+		void	reset();
+		size_t	count() const
+			{
+				return m_count;
+			};
+		double	quantile() const
+			{
+				return m_quantile;
+			};
+	private:
+		double	parabolic(int i, int d) const;
+		double	linear(int i, int d) const;
+		double	m_quantile;
+		size_t	m_count;
+		double	m_heights[5];
+		double	m_positions[5];
+		double	m_desired[5];
+		double	m_increments[5];
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _REDUCTION_H
+#define _REDUCTION_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <cstddef>
+#include <string>
+
+/**
+ * The reductions that may be applied to an array datapoint in order
+ * to obtain the single value that is monitored for change.
+ */
+typedef enum {
+	ReducePeak,
+	ReduceRMS,
+	ReduceMean,
+	ReduceCrestFactor
+} ArrayReduction;
+
+ArrayReduction	arrayReduction(const std::string& name);
+
+/**
+ * Summary statistics accumulated over the elements of one or more arrays.
+ * The accumulation uses vectorised kernels where the target supports them
+ * and falls back to a scalar loop otherwise.
+ */
+class ArrayStats {
+	public:
+		ArrayStats() : m_count(0), m_sum(0.0), m_sumSquares(0.0), m_peak(0.0)
+			{
+			};
+		void	accumulate(const double *values, size_t count);
+		void	accumulate(double value);
+		double	reduce(ArrayReduction reduction) const;
+		size_t	count() const
+			{
+				return m_count;
+			};
+	private:
+		size_t	m_count;
+		double	m_sum;
+		double	m_sumSquares;
+		double	m_peak;
+};
+
+void	addArray(double *sum, const double *values, size_t count);
+
+#endif
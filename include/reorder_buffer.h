@@ -0,0 +1,76 @@
+#ifndef _REORDER_BUFFER_H
+#define _REORDER_BUFFER_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <sys/time.h>
+#include <vector>
+#include <cstdint>
+
+/**
+ * A bounded buffer that holds back readings for a short period so that
+ * readings that arrive late may be released in user timestamp order.
+ * Readings are held in a min-heap on user timestamp and released once
+ * the newest timestamp seen is later than theirs by the configured
+ * lateness, or when the buffer is full. A lateness of zero disables
+ * the buffer.
+ */
+class ReorderBuffer {
+	public:
+		ReorderBuffer();
+		~ReorderBuffer();
+		void	configure(long lateness, size_t capacity);
+		void	add(Reading *reading);
+		void	release(std::vector<Reading *>& out);
+		void	drain(std::vector<Reading *>& out);
+		bool	enabled() const
+			{
+				return m_lateness > 0;
+			};
+		long	lateness() const
+			{
+				return m_lateness;
+			};
+		bool	empty() const
+			{
+				return m_heap.empty();
+			};
+		size_t	size() const
+			{
+				return m_heap.size();
+			};
+		uint64_t
+			lateReadings() const
+			{
+				return m_late;
+			};
+		size_t	bytes() const;
+	private:
+		class Entry {
+			public:
+				Entry(Reading *reading, uint64_t sequence);
+				bool	operator<(const Entry& rhs) const;
+				Reading		*m_reading;
+				struct timeval	m_timestamp;
+				uint64_t	m_sequence;
+				size_t		m_bytes;
+		};
+		void	pop(std::vector<Reading *>& out);
+		std::vector<Entry>	m_heap;
+		long			m_lateness;
+		size_t			m_capacity;
+		struct timeval		m_newest;
+		struct timeval		m_released;
+		uint64_t		m_sequence;
+		uint64_t		m_late;
+		size_t			m_bytes;
+};
+
+#endif
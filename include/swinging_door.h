@@ -0,0 +1,69 @@
+#ifndef _SWINGING_DOOR_H
+#define _SWINGING_DOOR_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+
+/**
+ * The point, if any, that must be archived as the result of adding a
+ * value to a swinging door compressor
+ */
+typedef enum {
+	ArchiveNone,
+	ArchivePrevious,
+	ArchiveCurrent
+} DoorArchive;
+
+/**
+ * Swinging door compression of a single datapoint. The archived points,
+ * joined by straight lines, reproduce every value of the datapoint to
+ * within the deviation. Each value is processed in constant time and
+ * only the last archived point and the last value are held.
+ *
+ * String values have no slope, they are archived whenever they change.
+ */
+class SwingingDoor {
+	public:
+		SwingingDoor(double deviation);
+		DoorArchive	update(double time, double value, bool integer);
+		bool		update(const std::string& value);
+		void		reset();
+		bool		pending() const
+			{
+				return m_open && m_lastTime != m_archiveTime;
+			};
+		double		lastTime() const
+			{
+				return m_lastTime;
+			};
+		double		lastValue() const
+			{
+				return m_lastValue;
+			};
+		bool		lastInteger() const
+			{
+				return m_lastInteger;
+			};
+	private:
+		void		open(double time, double value);
+		double		m_deviation;
+		bool		m_open;
+		double		m_archiveTime;
+		double		m_archiveValue;
+		double		m_lastTime;
+		double		m_lastValue;
+		bool		m_lastInteger;
+		double		m_upper;
+		double		m_lower;
+		bool		m_stringSent;
+		std::string	m_lastString;
+};
+
+#endif
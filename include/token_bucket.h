@@ -0,0 +1,37 @@
+#ifndef _TOKEN_BUCKET_H
+#define _TOKEN_BUCKET_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <sys/time.h>
+
+/**
+ * A token bucket used to limit the rate of output of the filter. Tokens
+ * are added at a fixed rate up to the capacity of the bucket and removed
+ * as data is sent. A rate of zero disables the bucket.
+ */
+class TokenBucket {
+	public:
+		TokenBucket();
+		void	configure(double rate, double capacity);
+		bool	consume(double tokens);
+		void	charge(double tokens);
+		bool	enabled() const
+			{
+				return m_rate > 0.0;
+			};
+	private:
+		void	refill();
+		double		m_rate;
+		double		m_capacity;
+		double		m_tokens;
+		struct timeval	m_last;
+};
+
+#endif
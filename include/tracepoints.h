@@ -0,0 +1,48 @@
+#ifndef _TRACEPOINTS_H
+#define _TRACEPOINTS_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+/*
+ * Static tracepoints for perf, bpftrace and SystemTap. When the plugin is
+ * built with CHANGE_TRACEPOINTS each tracepoint has a semaphore that the
+ * tracer increments when it attaches. The tracepoint is a test of the
+ * semaphore and a branch, the arguments are only evaluated when a tracer
+ * is attached. Without CHANGE_TRACEPOINTS the tracepoints compile to
+ * nothing.
+ *
+ * All the tracepoints are in the provider "change" and pass integer or
+ * string arguments only, so they may be read by any tracer. A tracepoint
+ * must have its semaphore declared here and defined in tracepoints.cpp.
+ */
+#ifdef CHANGE_TRACEPOINTS
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define CHANGE_SEMAPHORE(name)	change_##name##_semaphore
+#define CHANGE_ENABLED(name)	__builtin_expect(CHANGE_SEMAPHORE(name) != 0, 0)
+
+extern volatile unsigned short	CHANGE_SEMAPHORE(ingest_entry);
+extern volatile unsigned short	CHANGE_SEMAPHORE(ingest_return);
+extern volatile unsigned short	CHANGE_SEMAPHORE(trigger_fire);
+extern volatile unsigned short	CHANGE_SEMAPHORE(trigger_expire);
+extern volatile unsigned short	CHANGE_SEMAPHORE(pretrigger_send);
+extern volatile unsigned short	CHANGE_SEMAPHORE(average);
+
+#define CHANGE_TRACE2(name, a, b)		do { if (CHANGE_ENABLED(name)) \
+							STAP_PROBE2(change, name, a, b); } while (0)
+#define CHANGE_TRACE3(name, a, b, c)		do { if (CHANGE_ENABLED(name)) \
+							STAP_PROBE3(change, name, a, b, c); } while (0)
+#else
+#define CHANGE_TRACE2(name, a, b)		do { } while (0)
+#define CHANGE_TRACE3(name, a, b, c)		do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+/*
+ * Fledge change filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+/**
+ * A small pool of threads that run a set of independent tasks in
+ * parallel with the calling thread. The tasks are numbered, each thread
+ * claims the next unclaimed task with a single atomic increment so that
+ * a thread that finishes early takes on the work the others have not
+ * yet started. The caller returns once every task has been run.
+ */
+class WorkerPool {
+	public:
+		WorkerPool(unsigned int threads);
+		~WorkerPool();
+		void		run(size_t tasks, const std::function<void (size_t)>& work);
+		unsigned int	threads() const
+				{
+					return m_threads.size() + 1;
+				};
+	private:
+		void		worker();
+		void		execute();
+		std::vector<std::thread>
+					m_threads;
+		std::mutex		m_mutex;
+		std::condition_variable	m_start;
+		std::condition_variable	m_done;
+		const std::function<void (size_t)>
+					*m_work;
+		size_t			m_tasks;
+		std::atomic<size_t>	m_next;
+		unsigned int		m_active;
+		unsigned long		m_generation;
+		bool			m_shutdown;
+};
+
+#endif
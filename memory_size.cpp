@@ -0,0 +1,141 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <memory_size.h>
+#include <cstdlib>
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The chunk sizes of the allocator. The glibc allocator adds a size word
+ * to each request, rounds up to its alignment and has a minimum chunk of
+ * four words. Other allocators are assumed to do the same, the figures
+ * are then only an estimate.
+ */
+#ifdef MALLOC_ALIGNMENT
+static const size_t chunkAlignment = MALLOC_ALIGNMENT;
+#else
+static const size_t chunkAlignment = 2 * sizeof(size_t) > alignof(max_align_t)
+					? 2 * sizeof(size_t) : alignof(max_align_t);
+#endif
+static const size_t chunkOverhead = sizeof(size_t);
+static const size_t chunkMinimum = (4 * sizeof(size_t) + chunkAlignment - 1) & ~(chunkAlignment - 1);
+
+/**
+ * The heap used by a single allocation, the request plus the allocator
+ * overhead rounded up to the allocator alignment
+ *
+ * @param request	The number of bytes requested
+ * @return		The number of bytes of heap used
+ */
+size_t heapBytes(size_t request)
+{
+	size_t chunk = (request + chunkOverhead + chunkAlignment - 1) & ~(chunkAlignment - 1);
+	return chunk < chunkMinimum ? chunkMinimum : chunk;
+}
+
+/**
+ * The heap used by the contents of a string. Short strings are held
+ * within the string object and use no heap, the capacity of an empty
+ * string is the longest string held this way.
+ *
+ * @param length	The length of the string
+ * @return		The number of bytes of heap used
+ */
+size_t stringBytes(size_t length)
+{
+	static const size_t local = string().capacity();
+	return length <= local ? 0 : heapBytes(length + 1);
+}
+
+/**
+ * The heap used by the elements of a vector
+ *
+ * @param capacity	The capacity of the vector
+ * @param element	The size of an element
+ * @return		The number of bytes of heap used
+ */
+size_t vectorBytes(size_t capacity, size_t element)
+{
+	return capacity ? heapBytes(capacity * element) : 0;
+}
+
+/**
+ * The heap used by a datapoint, including the value it holds
+ *
+ * @param datapoint	The datapoint
+ * @return		The number of bytes of heap used
+ */
+size_t datapointBytes(Datapoint *datapoint)
+{
+size_t	bytes = heapBytes(sizeof(Datapoint)) + stringBytes(datapoint->getName().size());
+
+	DatapointValue& data = datapoint->getData();
+	switch (data.getType())
+	{
+		case DatapointValue::T_STRING:
+			bytes += heapBytes(sizeof(string)) + stringBytes(data.toString().size());
+			break;
+		case DatapointValue::T_FLOAT_ARRAY:
+			bytes += heapBytes(sizeof(vector<double>))
+				+ heapBytes(data.getDpArr()->capacity() * sizeof(double));
+			break;
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			vector<vector<double>* > *rows = data.getDp2DArr();
+			bytes += heapBytes(sizeof(vector<vector<double>* >))
+				+ heapBytes(rows->capacity() * sizeof(vector<double> *));
+			for (auto row = rows->cbegin(); row != rows->cend(); ++row)
+			{
+				bytes += heapBytes(sizeof(vector<double>))
+					+ heapBytes((*row)->capacity() * sizeof(double));
+			}
+			break;
+		}
+		case DatapointValue::T_DP_LIST:
+		case DatapointValue::T_DP_DICT:
+		{
+			vector<Datapoint *> *children = data.getDpVec();
+			bytes += heapBytes(sizeof(vector<Datapoint *>))
+				+ heapBytes(children->capacity() * sizeof(Datapoint *));
+			for (auto child = children->cbegin(); child != children->cend(); ++child)
+			{
+				bytes += datapointBytes(*child);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return bytes;
+}
+
+/**
+ * The heap used by a reading and its datapoints
+ *
+ * @param reading	The reading
+ * @return		The number of bytes of heap used
+ */
+size_t readingBytes(Reading *reading)
+{
+size_t	bytes = heapBytes(sizeof(Reading)) + stringBytes(reading->getAssetName().size());
+
+	vector<Datapoint *>& datapoints = reading->getReadingData();
+	if (datapoints.capacity())
+	{
+		bytes += heapBytes(datapoints.capacity() * sizeof(Datapoint *));
+	}
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
+	{
+		bytes += datapointBytes(*it);
+	}
+	return bytes;
+}
@@ -0,0 +1,113 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <output_queue.h>
+#include <chrono>
+
+using namespace std;
+
+/**
+ * Construct an output queue
+ *
+ * @param capacity	The number of reading sets the queue may hold
+ */
+OutputQueue::OutputQueue(size_t capacity) : m_capacity(capacity ? capacity : 1),
+				m_head(0), m_tail(0), m_producerWaiting(false),
+				m_consumerWaiting(false), m_closed(false), m_waitTime(0)
+{
+	m_ring.resize(m_capacity, NULL);
+}
+
+/**
+ * Destroy the queue, any reading sets that were not delivered are deleted
+ */
+OutputQueue::~OutputQueue()
+{
+	while (m_head.load() != m_tail.load())
+	{
+		delete m_ring[m_head.load() % m_capacity];
+		m_head.store(m_head.load() + 1);
+	}
+}
+
+/**
+ * Wake the other side of the queue if it is sleeping
+ *
+ * @param waiting	The waiting flag of the other side
+ */
+void OutputQueue::wake(atomic<bool>& waiting)
+{
+	if (waiting.load())
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * Append a reading set to the queue. If the queue is full the caller
+ * blocks until the consumer has made space, the time spent blocked is
+ * added to the wait time of the queue.
+ *
+ * @param readingSet	The reading set to append
+ */
+void OutputQueue::push(ReadingSet *readingSet)
+{
+	size_t tail = m_tail.load();
+	if (tail - m_head.load() >= m_capacity)
+	{
+		auto start = chrono::steady_clock::now();
+		unique_lock<mutex> lock(m_mutex);
+		m_producerWaiting.store(true);
+		m_cv.wait(lock, [this, tail] { return tail - m_head.load() < m_capacity; });
+		m_producerWaiting.store(false);
+		m_waitTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::steady_clock::now() - start).count();
+	}
+	m_ring[tail % m_capacity] = readingSet;
+	m_tail.store(tail + 1);
+	wake(m_consumerWaiting);
+}
+
+/**
+ * Remove the reading set at the head of the queue, blocking until one is
+ * available.
+ *
+ * @return	The reading set or NULL if the queue is closed and empty
+ */
+ReadingSet *OutputQueue::pop()
+{
+	size_t head = m_head.load();
+	if (head == m_tail.load())
+	{
+		unique_lock<mutex> lock(m_mutex);
+		m_consumerWaiting.store(true);
+		m_cv.wait(lock, [this, head] { return head != m_tail.load() || m_closed.load(); });
+		m_consumerWaiting.store(false);
+		if (head == m_tail.load())
+		{
+			return NULL;
+		}
+	}
+	ReadingSet *readingSet = m_ring[head % m_capacity];
+	m_head.store(head + 1);
+	wake(m_producerWaiting);
+	return readingSet;
+}
+
+/**
+ * Close the queue, the consumer will drain any remaining reading sets
+ * and then receive NULL.
+ */
+void OutputQueue::close()
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_closed.store(true);
+	m_cv.notify_all();
+}
@@ -83,7 +83,332 @@ static const char *default_config = QUOTE({
 			"default": "per second",
 			"order" : "7",
 			"displayName" : "Rate Units"
-	       		}
+	       		},
+		"arrayReduction": {
+			"description": "The reduction used to obtain the value to monitor when the trigger datapoint is an array",
+			"type": "enumeration",
+			"options" : [ "peak", "rms", "mean", "crest factor" ],
+			"default": "peak",
+			"order" : "8",
+			"displayName" : "Array Reduction"
+			},
+		"decimation": {
+			"description": "The decimation applied to the asset once the full rate period of a triggered window has passed",
+			"type": "enumeration",
+			"options" : [ "none", "by time", "by count", "curve" ],
+			"default": "none",
+			"order" : "9",
+			"displayName" : "Post-trigger Decimation"
+			},
+		"fullRatePeriod": {
+			"description": "The time after a change during which all data is sent before any decimation is applied, expressed in milliseconds",
+			"type": "integer",
+			"default": "0",
+			"order" : "10",
+			"displayName" : "Full rate period (mS)",
+			"validity" : "decimation != \"none\""
+			},
+		"decimationInterval": {
+			"description": "The decimation interval, milliseconds between readings when decimating by time or 1 in N readings when decimating by count",
+			"type": "integer",
+			"default": "1",
+			"minimum": "1",
+			"order" : "11",
+			"displayName" : "Decimation interval",
+			"validity" : "decimation == \"by time\" || decimation == \"by count\""
+			},
+		"decimationCurve": {
+			"description": "A comma separated list of elapsed:factor pairs, sending 1 in factor readings once elapsed milliseconds have passed since the change",
+			"type": "string",
+			"default": "1000:2, 5000:10",
+			"order" : "12",
+			"displayName" : "Decimation curve",
+			"validity" : "decimation == \"curve\""
+			},
+		"untriggeredMode": {
+			"description": "How readings of the asset are sent when the filter has not triggered, either averaged at the reduced rate, reporting only the datapoints that have changed or compressed within the deadband by swinging door compression",
+			"type": "enumeration",
+			"options" : [ "average", "report by exception", "swinging door" ],
+			"default": "average",
+			"order" : "13",
+			"displayName" : "Untriggered Data"
+			},
+		"deadband": {
+			"description": "The change in value of a datapoint that must be exceeded before it is reported, or the maximum error of swinging door compression, 0 implies any change of value",
+			"type": "float",
+			"default": "0",
+			"order" : "14",
+			"displayName" : "Deadband",
+			"validity" : "untriggeredMode != \"average\""
+			},
+		"deadbands": {
+			"description": "A comma separated list of datapoint:deadband pairs that override the deadband for individual datapoints",
+			"type": "string",
+			"default": "",
+			"order" : "15",
+			"displayName" : "Datapoint Deadbands",
+			"validity" : "untriggeredMode != \"average\""
+			},
+		"budget": {
+			"description": "The maximum rate at which triggered data for the asset is sent, 0 implies no limit",
+			"type": "integer",
+			"default": "0",
+			"minimum": "0",
+			"order" : "16",
+			"displayName" : "Output Budget"
+			},
+		"budgetUnit": {
+			"description": "The unit in which the output budget is expressed",
+			"type": "enumeration",
+			"options" : [ "readings per second", "bytes per second" ],
+			"default": "readings per second",
+			"order" : "17",
+			"displayName" : "Output Budget Units",
+			"validity" : "budget != \"0\""
+			},
+		"budgetBurst": {
+			"description": "The number of seconds worth of output budget that may be used in a single burst",
+			"type": "integer",
+			"default": "1",
+			"minimum": "1",
+			"order" : "18",
+			"displayName" : "Output Budget Burst (S)",
+			"validity" : "budget != \"0\""
+			},
+		"budgetAction": {
+			"description": "The action taken with triggered readings that exceed the output budget, either drop them or send an average of them",
+			"type": "enumeration",
+			"options" : [ "decimate", "average" ],
+			"default": "decimate",
+			"order" : "19",
+			"displayName" : "Output Budget Action",
+			"validity" : "budget != \"0\""
+			},
+		"minimumHold": {
+			"description": "The time for which a change must persist before the filter triggers, expressed in milliseconds, 0 implies trigger immediately",
+			"type": "integer",
+			"default": "0",
+			"minimum": "0",
+			"order" : "20",
+			"displayName" : "Minimum Hold (mS)"
+			},
+		"maximumWindow": {
+			"description": "The maximum length of a triggered window, however many further changes occur, expressed in milliseconds, 0 implies no limit",
+			"type": "integer",
+			"default": "0",
+			"minimum": "0",
+			"order" : "21",
+			"displayName" : "Maximum Window (mS)"
+			},
+		"rearmHoldoff": {
+			"description": "The time after a triggered window ends during which changes will not trigger the filter, expressed in milliseconds",
+			"type": "integer",
+			"default": "0",
+			"minimum": "0",
+			"order" : "22",
+			"displayName" : "Re-arm Holdoff (mS)"
+			},
+		"idleFlush": {
+			"description": "Send the average at the end of each reduced rate period even if no further readings of the asset arrive",
+			"type": "boolean",
+			"default": "false",
+			"order" : "23",
+			"displayName" : "Flush Idle Averages",
+			"validity" : "rate != \"0\""
+			},
+		"alignPeriods": {
+			"description": "Align the reduced rate periods to the clock rather than to the time the last average was sent",
+			"type": "boolean",
+			"default": "false",
+			"order" : "24",
+			"displayName" : "Align Periods",
+			"validity" : "rate != \"0\""
+			},
+		"alignmentOffset": {
+			"description": "The offset of the aligned periods from the clock, expressed in seconds",
+			"type": "integer",
+			"default": "0",
+			"order" : "25",
+			"displayName" : "Alignment Offset (S)",
+			"validity" : "alignPeriods == \"true\""
+			},
+		"emptyPeriods": {
+			"description": "How aligned periods in which no readings arrive are sent",
+			"type": "enumeration",
+			"options" : [ "omit", "repeat last", "no data" ],
+			"default": "omit",
+			"order" : "26",
+			"displayName" : "Empty Periods",
+			"validity" : "alignPeriods == \"true\""
+			},
+		"earlyEmit": {
+			"description": "Send the pre-trigger data and the reading that triggered as soon as the trigger is detected rather than at the end of the batch of readings",
+			"type": "boolean",
+			"default": "false",
+			"order" : "27",
+			"displayName" : "Send Trigger Immediately"
+			},
+		"asyncOutput": {
+			"description": "Deliver the output of the filter on a separate thread so that filtering of the next batch of readings overlaps delivery of the last",
+			"type": "boolean",
+			"default": "false",
+			"order" : "28",
+			"displayName" : "Asynchronous Output"
+			},
+		"outputQueueDepth": {
+			"description": "The number of batches of readings that may be waiting for delivery before the filter blocks",
+			"type": "integer",
+			"default": "8",
+			"minimum": "1",
+			"order" : "29",
+			"displayName" : "Output Queue Depth",
+			"validity" : "asyncOutput == \"true\""
+			},
+		"reorderWindow": {
+			"description": "The time in milliseconds by which readings of the monitored asset may arrive late. Readings are held for this long so that they can be processed in timestamp order, 0 disables reordering",
+			"type": "integer",
+			"default": "0",
+			"minimum": "0",
+			"order" : "30",
+			"displayName" : "Reorder Window (ms)"
+			},
+		"reorderLimit": {
+			"description": "The maximum number of readings held for reordering, the oldest are released when the limit is reached",
+			"type": "integer",
+			"default": "1000",
+			"minimum": "1",
+			"order" : "31",
+			"displayName" : "Reorder Limit",
+			"validity" : "reorderWindow != \"0\""
+			},
+		"eventSummary": {
+			"description": "Send a single summary reading for each triggered window, either with the data of the window or instead of it",
+			"type": "enumeration",
+			"options" : [ "none", "with data", "instead of data" ],
+			"default": "none",
+			"order" : "32",
+			"displayName" : "Event Summary"
+			},
+		"assetMatch": {
+			"description": "How the asset is matched against the asset names of the readings. A wildcard or regular expression monitors each matching asset separately",
+			"type": "enumeration",
+			"options" : [ "exact", "wildcard", "regular expression" ],
+			"default": "exact",
+			"order" : "33",
+			"displayName" : "Asset Matching"
+			},
+		"quantiles": {
+			"description": "A comma separated list of quantiles, between 0 and 1, that are estimated for each numeric datapoint and sent with the reduced rate average, e.g. 0.5, 0.95, 0.99",
+			"type": "string",
+			"default": "",
+			"order" : "34",
+			"displayName" : "Quantiles",
+			"validity" : "untriggeredMode == \"average\""
+			},
+		"adaptiveRate": {
+			"description": "Adapt the reduced rate period to the activity of the trigger datapoint, sending averages more often when the signal is active",
+			"type": "boolean",
+			"default": "false",
+			"order" : "35",
+			"displayName" : "Adaptive Rate",
+			"validity" : "untriggeredMode == \"average\" && alignPeriods == \"false\""
+			},
+		"minimumInterval": {
+			"description": "The shortest reduced rate period in milliseconds, used when the trigger datapoint is most active",
+			"type": "integer",
+			"default": "1000",
+			"order" : "36",
+			"displayName" : "Minimum Interval (ms)",
+			"validity" : "adaptiveRate == \"true\""
+			},
+		"maximumInterval": {
+			"description": "The longest reduced rate period in milliseconds, used when the trigger datapoint is flat",
+			"type": "integer",
+			"default": "60000",
+			"order" : "37",
+			"displayName" : "Maximum Interval (ms)",
+			"validity" : "adaptiveRate == \"true\""
+			},
+		"activity": {
+			"description": "The standard deviation of the trigger datapoint within a period at or above which the minimum interval is used",
+			"type": "float",
+			"default": "1.0",
+			"order" : "38",
+			"displayName" : "Activity Scale",
+			"validity" : "adaptiveRate == \"true\""
+			},
+		"preTriggerCount": {
+			"description": "The maximum number of readings to send prior to the trigger firing. The buffer for these readings is allocated when the filter is configured. A value of 0 implies no limit on the number of readings",
+			"type": "integer",
+			"default": "0",
+			"order" : "39",
+			"displayName" : "Pre-trigger Readings"
+			},
+		"coalesceReadings": {
+			"description": "Hold the output of the filter until this number of readings has been collected, then send them onwards as a single set. A value of 0 disables coalescing by count",
+			"type": "integer",
+			"default": "0",
+			"order" : "40",
+			"displayName" : "Coalesce Readings"
+			},
+		"coalesceTime": {
+			"description": "The maximum time in milliseconds that output is held for coalescing. A value of 0 disables coalescing by time",
+			"type": "integer",
+			"default": "0",
+			"order" : "41",
+			"displayName" : "Coalesce Time (ms)"
+			},
+		"suppressEmpty": {
+			"description": "Do not pass empty sets of readings onwards. Empty sets are never passed on when coalescing",
+			"type": "boolean",
+			"default": "false",
+			"order" : "42",
+			"displayName" : "Suppress Empty Output"
+			},
+		"flightRecorder": {
+			"description": "The number of decisions made by the filter that are kept in memory by the flight recorder. A value of 0 disables the recorder",
+			"type": "integer",
+			"default": "1024",
+			"order" : "43",
+			"displayName" : "Flight Recorder Size"
+			},
+		"recorderFile": {
+			"description": "The file to which the flight recorder is written on demand and when the filter shuts down. If not given the recorder is only written on demand, to a file in the Fledge data directory named after the filter",
+			"type": "string",
+			"default": "",
+			"order" : "44",
+			"displayName" : "Flight Recorder File"
+			},
+		"dumpRecorder": {
+			"description": "Write the flight recorder to the recorder file when this is set",
+			"type": "boolean",
+			"default": "false",
+			"order" : "45",
+			"displayName" : "Dump Flight Recorder"
+			},
+		"memoryLimit": {
+			"description": "The maximum memory in kilobytes the filter may use. When it is reached the oldest pre-trigger data is discarded. When matching a pattern the limit is shared between the matching assets. A value of 0 implies no limit",
+			"type": "integer",
+			"default": "0",
+			"order" : "46",
+			"displayName" : "Memory Limit (KB)"
+			},
+		"maxAssets": {
+			"description": "The maximum number of asset names remembered when matching by wildcard or regular expression. The asset seen least recently is forgotten, along with its trigger state, when the limit is reached",
+			"type": "integer",
+			"default": "1000",
+			"order" : "47",
+			"displayName" : "Maximum Assets",
+			"validity" : "assetMatch != \"exact\""
+			},
+		"parallelAssets": {
+			"description": "The number of threads used to process the assets that match a wildcard or regular expression in parallel. The readings of each asset are processed in order by one thread and the output is merged in the order the readings arrived. A value of 0 or 1 processes the assets on the calling thread",
+			"type": "integer",
+			"default": "0",
+			"order" : "48",
+			"displayName" : "Parallel Asset Threads",
+			"validity" : "assetMatch != \"exact\""
+			}
 	});
 
 using namespace std;
@@ -149,9 +474,10 @@ void plugin_ingest(PLUGIN_HANDLE handle,
 	{
 		/*
 		 * Current filter is not active: just pass the readings
-		 * set along the filter chain
+		 * set along the filter chain, behind any output the filter
+		 * still holds
 		 */
-		filter->m_func(filter->m_data, readingSet);
+		filter->passThrough((ReadingSet *)readingSet);
 		return;
 	}
 
@@ -181,18 +507,12 @@ void plugin_ingest(PLUGIN_HANDLE handle,
 	/*
 	 * Create a new reading set and pass it up the filter
 	 * chain. Note this reading set may not contain any
-	 * actual readings.
+	 * actual readings, the filter may suppress it or hold
+	 * it for coalescing. The filter adds the asset tracking
+	 * tuples for the readings it sends.
 	 */
 	ReadingSet *newReadingSet = new ReadingSet(&out);
-	const vector<Reading *>& readings2 = newReadingSet->getAllReadings();
-	for (vector<Reading *>::const_iterator elem = readings2.begin();
-						      elem != readings2.end();
-						      ++elem)
-	{
-		if (assetTrackerInstance != nullptr)
-			assetTrackerInstance->addAssetTrackingTuple(filter->getName(), (*elem)->getAssetName(), string("Filter"));
-	}
-	filter->m_func(filter->m_data, newReadingSet);
+	filter->output(newReadingSet);
 }
 
 /**
@@ -0,0 +1,137 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <pretrigger_ring.h>
+#include <memory_size.h>
+
+using namespace std;
+
+/**
+ * Construct an empty ring with no count limit
+ */
+PretriggerRing::PretriggerRing() : m_head(0), m_count(0), m_capacity(0), m_bytes(0)
+{
+}
+
+/**
+ * Destructor for the ring, any readings still held are discarded
+ */
+PretriggerRing::~PretriggerRing()
+{
+	clear();
+}
+
+/**
+ * Set the maximum number of readings the ring holds. The slots for a
+ * fixed capacity are allocated here so that no allocation takes place
+ * as readings are buffered. If the ring holds more readings than the
+ * new capacity the oldest are discarded.
+ *
+ * @param capacity	The number of readings to hold, zero for no limit
+ */
+void PretriggerRing::configure(size_t capacity)
+{
+	if (capacity == m_capacity)
+	{
+		return;
+	}
+	m_capacity = capacity;
+	if (capacity)
+	{
+		while (m_count > capacity)
+		{
+			delete front();
+			pop();
+		}
+		resize(capacity);
+	}
+}
+
+/**
+ * Add a reading to the ring, which takes ownership of it. If the ring
+ * is at its capacity the oldest reading is discarded.
+ *
+ * @param reading	The reading to add
+ * @return		True if the oldest reading was discarded
+ */
+bool PretriggerRing::push(Reading *reading)
+{
+bool	evicted = false;
+
+	if (m_count == m_slots.size())
+	{
+		if (m_capacity)
+		{
+			delete front();
+			pop();
+			evicted = true;
+		}
+		else
+		{
+			resize(m_slots.empty() ? 16 : m_slots.size() * 2);
+		}
+	}
+	Slot& slot = m_slots[(m_head + m_count) % m_slots.size()];
+	slot.m_reading = reading;
+	slot.m_bytes = readingBytes(reading);
+	m_bytes += slot.m_bytes;
+	m_count++;
+	return evicted;
+}
+
+/**
+ * Remove the oldest reading from the ring. The caller takes ownership
+ * of the reading, which should first be retrieved with front().
+ */
+void PretriggerRing::pop()
+{
+	m_bytes -= m_slots[m_head].m_bytes;
+	m_slots[m_head] = Slot();
+	m_head = (m_head + 1) % m_slots.size();
+	m_count--;
+}
+
+/**
+ * Discard all the readings held in the ring
+ */
+void PretriggerRing::clear()
+{
+	while (m_count)
+	{
+		delete front();
+		pop();
+	}
+	m_head = 0;
+}
+
+/**
+ * Move the readings held into a new set of slots, oldest first
+ *
+ * @param slots	The number of slots to allocate
+ */
+void PretriggerRing::resize(size_t slots)
+{
+	vector<Slot> resized(slots);
+	for (size_t i = 0; i < m_count; i++)
+	{
+		resized[i] = m_slots[(m_head + i) % m_slots.size()];
+	}
+	m_slots.swap(resized);
+	m_head = 0;
+}
+
+/**
+ * The heap used by the ring and the readings it holds
+ *
+ * @return	The number of bytes of heap used
+ */
+size_t PretriggerRing::bytes() const
+{
+	return m_bytes + (m_slots.empty() ? 0 : heapBytes(m_slots.size() * sizeof(Slot)));
+}
@@ -0,0 +1,157 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <quantile.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * Construct an estimator for a quantile
+ *
+ * @param quantile	The quantile to estimate, between 0 and 1
+ */
+P2Quantile::P2Quantile(double quantile) : m_quantile(quantile)
+{
+	reset();
+}
+
+/**
+ * Discard the values added so far
+ */
+void P2Quantile::reset()
+{
+	m_count = 0;
+	for (int i = 0; i < 5; i++)
+	{
+		m_heights[i] = 0.0;
+		m_positions[i] = i;
+	}
+	m_desired[0] = 0.0;
+	m_desired[1] = 2 * m_quantile;
+	m_desired[2] = 4 * m_quantile;
+	m_desired[3] = 2 + 2 * m_quantile;
+	m_desired[4] = 4.0;
+	m_increments[0] = 0.0;
+	m_increments[1] = m_quantile / 2;
+	m_increments[2] = m_quantile;
+	m_increments[3] = (1 + m_quantile) / 2;
+	m_increments[4] = 1.0;
+}
+
+/**
+ * Add a value to the estimate
+ *
+ * @param value	The value to add
+ */
+void P2Quantile::add(double value)
+{
+	if (m_count < 5)
+	{
+		// Hold the first five values in order
+		m_heights[m_count++] = value;
+		sort(m_heights, m_heights + m_count);
+		return;
+	}
+	m_count++;
+
+	int k;
+	if (value < m_heights[0])
+	{
+		m_heights[0] = value;
+		k = 0;
+	}
+	else if (value >= m_heights[4])
+	{
+		m_heights[4] = value;
+		k = 3;
+	}
+	else
+	{
+		for (k = 0; k < 3 && value >= m_heights[k + 1]; k++)
+			;
+	}
+	for (int i = k + 1; i < 5; i++)
+	{
+		m_positions[i]++;
+	}
+	for (int i = 0; i < 5; i++)
+	{
+		m_desired[i] += m_increments[i];
+	}
+
+	// Move the middle markers towards their desired positions
+	for (int i = 1; i < 4; i++)
+	{
+		double delta = m_desired[i] - m_positions[i];
+		if ((delta >= 1.0 && m_positions[i + 1] - m_positions[i] > 1.0)
+				|| (delta <= -1.0 && m_positions[i - 1] - m_positions[i] < -1.0))
+		{
+			int d = delta > 0 ? 1 : -1;
+			double height = parabolic(i, d);
+			if (m_heights[i - 1] < height && height < m_heights[i + 1])
+			{
+				m_heights[i] = height;
+			}
+			else
+			{
+				m_heights[i] = linear(i, d);
+			}
+			m_positions[i] += d;
+		}
+	}
+}
+
+/**
+ * The piecewise parabolic prediction of the height of a marker moved
+ * by one position
+ *
+ * @param i	The marker
+ * @param d	The direction of the move
+ */
+double P2Quantile::parabolic(int i, int d) const
+{
+	return m_heights[i] + d / (m_positions[i + 1] - m_positions[i - 1])
+		* ((m_positions[i] - m_positions[i - 1] + d) * (m_heights[i + 1] - m_heights[i])
+				/ (m_positions[i + 1] - m_positions[i])
+			+ (m_positions[i + 1] - m_positions[i] - d) * (m_heights[i] - m_heights[i - 1])
+				/ (m_positions[i] - m_positions[i - 1]));
+}
+
+/**
+ * The linear prediction of the height of a marker moved by one position,
+ * used when the parabolic prediction is out of order
+ *
+ * @param i	The marker
+ * @param d	The direction of the move
+ */
+double P2Quantile::linear(int i, int d) const
+{
+	return m_heights[i] + d * (m_heights[i + d] - m_heights[i])
+		/ (m_positions[i + d] - m_positions[i]);
+}
+
+/**
+ * Return the estimate of the quantile. With fewer than five values the
+ * nearest of the values held is returned.
+ */
+double P2Quantile::value() const
+{
+	if (m_count == 0)
+	{
+		return 0.0;
+	}
+	if (m_count <= 5)
+	{
+		size_t index = (size_t)llround(m_quantile * (m_count - 1));
+		return m_heights[index];
+	}
+	return m_heights[2];
+}
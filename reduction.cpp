@@ -0,0 +1,159 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reduction.h>
+#include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+/**
+ * Map the configured name of a reduction onto the reduction to apply.
+ * Unrecognised names result in the peak reduction.
+ *
+ * @param name	The name of the reduction
+ */
+ArrayReduction arrayReduction(const string& name)
+{
+	if (name.compare("rms") == 0)
+		return ReduceRMS;
+	if (name.compare("mean") == 0)
+		return ReduceMean;
+	if (name.compare("crest factor") == 0)
+		return ReduceCrestFactor;
+	return ReducePeak;
+}
+
+/**
+ * Accumulate a block of values into the statistics. The vector kernels
+ * process two doubles per lane and leave any odd trailing element to the
+ * scalar loop.
+ *
+ * @param values	The values to accumulate
+ * @param count		The number of values
+ */
+void ArrayStats::accumulate(const double *values, size_t count)
+{
+size_t	i = 0;
+double	sum = 0.0, sumSquares = 0.0, peak = m_peak;
+
+#if defined(__SSE2__)
+	const __m128d signMask = _mm_set1_pd(-0.0);
+	__m128d vsum = _mm_setzero_pd();
+	__m128d vsq = _mm_setzero_pd();
+	__m128d vpeak = _mm_set1_pd(peak);
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128d v = _mm_loadu_pd(values + i);
+		vsum = _mm_add_pd(vsum, v);
+		vsq = _mm_add_pd(vsq, _mm_mul_pd(v, v));
+		vpeak = _mm_max_pd(vpeak, _mm_andnot_pd(signMask, v));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, vsum);
+	sum = lanes[0] + lanes[1];
+	_mm_storeu_pd(lanes, vsq);
+	sumSquares = lanes[0] + lanes[1];
+	_mm_storeu_pd(lanes, vpeak);
+	peak = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	float64x2_t vsum = vdupq_n_f64(0.0);
+	float64x2_t vsq = vdupq_n_f64(0.0);
+	float64x2_t vpeak = vdupq_n_f64(peak);
+	for (; i + 2 <= count; i += 2)
+	{
+		float64x2_t v = vld1q_f64(values + i);
+		vsum = vaddq_f64(vsum, v);
+		vsq = vfmaq_f64(vsq, v, v);
+		vpeak = vmaxq_f64(vpeak, vabsq_f64(v));
+	}
+	sum = vaddvq_f64(vsum);
+	sumSquares = vaddvq_f64(vsq);
+	peak = vmaxvq_f64(vpeak);
+#endif
+	for (; i < count; i++)
+	{
+		double v = values[i];
+		sum += v;
+		sumSquares += v * v;
+		if (fabs(v) > peak)
+			peak = fabs(v);
+	}
+	m_count += count;
+	m_sum += sum;
+	m_sumSquares += sumSquares;
+	m_peak = peak;
+}
+
+/**
+ * Accumulate a single value into the statistics
+ *
+ * @param value	The value to accumulate
+ */
+void ArrayStats::accumulate(double value)
+{
+	accumulate(&value, 1);
+}
+
+/**
+ * Return the requested reduction of the accumulated values. An empty
+ * set of values reduces to zero.
+ *
+ * @param reduction	The reduction to return
+ */
+double ArrayStats::reduce(ArrayReduction reduction) const
+{
+	if (m_count == 0)
+		return 0.0;
+	double rms = sqrt(m_sumSquares / m_count);
+	switch (reduction)
+	{
+		case ReduceRMS:
+			return rms;
+		case ReduceMean:
+			return m_sum / m_count;
+		case ReduceCrestFactor:
+			return rms > 0.0 ? m_peak / rms : 0.0;
+		case ReducePeak:
+		default:
+			return m_peak;
+	}
+}
+
+/**
+ * Add the elements of an array to a running element-wise sum.
+ *
+ * @param sum		The running sum, updated in place
+ * @param values	The values to add
+ * @param count		The number of elements in both arrays
+ */
+void addArray(double *sum, const double *values, size_t count)
+{
+size_t	i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 2 <= count; i += 2)
+	{
+		_mm_storeu_pd(sum + i, _mm_add_pd(_mm_loadu_pd(sum + i), _mm_loadu_pd(values + i)));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	for (; i + 2 <= count; i += 2)
+	{
+		vst1q_f64(sum + i, vaddq_f64(vld1q_f64(sum + i), vld1q_f64(values + i)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		sum[i] += values[i];
+	}
+}
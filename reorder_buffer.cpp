@@ -0,0 +1,161 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reorder_buffer.h>
+#include <memory_size.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Construct a heap entry for a reading
+ *
+ * @param reading	The reading to hold
+ * @param sequence	The order in which the reading arrived
+ */
+ReorderBuffer::Entry::Entry(Reading *reading, uint64_t sequence) :
+		m_reading(reading), m_sequence(sequence), m_bytes(readingBytes(reading))
+{
+	reading->getUserTimestamp(&m_timestamp);
+}
+
+/**
+ * Order entries such that the standard heap algorithms, which build a
+ * max-heap, place the oldest reading at the top. Readings with the same
+ * timestamp are released in the order they arrived.
+ *
+ * @param rhs	The entry to compare with
+ */
+bool ReorderBuffer::Entry::operator<(const Entry& rhs) const
+{
+	if (timercmp(&m_timestamp, &rhs.m_timestamp, !=))
+	{
+		return timercmp(&m_timestamp, &rhs.m_timestamp, >);
+	}
+	return m_sequence > rhs.m_sequence;
+}
+
+/**
+ * Construct a disabled reorder buffer
+ */
+ReorderBuffer::ReorderBuffer() : m_lateness(0), m_capacity(0), m_sequence(0), m_late(0),
+				m_bytes(0)
+{
+	timerclear(&m_newest);
+	timerclear(&m_released);
+}
+
+/**
+ * Destructor for the reorder buffer, any readings still held are discarded
+ */
+ReorderBuffer::~ReorderBuffer()
+{
+	for (auto& entry : m_heap)
+	{
+		delete entry.m_reading;
+	}
+}
+
+/**
+ * Set the lateness that is tolerated and the maximum number of readings
+ * that may be held. Readings already held are retained.
+ *
+ * @param lateness	The lateness in milliseconds, 0 disables the buffer
+ * @param capacity	The maximum number of readings to hold
+ */
+void ReorderBuffer::configure(long lateness, size_t capacity)
+{
+	m_lateness = lateness;
+	m_capacity = capacity < 1 ? 1 : capacity;
+	m_heap.reserve(m_capacity + 1);
+}
+
+/**
+ * Add a reading to the buffer. A reading that is older than one that
+ * has already been released can not be put back in order, it is counted
+ * as late and will be released at the next opportunity.
+ *
+ * @param reading	The reading to hold
+ */
+void ReorderBuffer::add(Reading *reading)
+{
+	m_heap.push_back(Entry(reading, m_sequence++));
+	m_bytes += m_heap.back().m_bytes;
+	const struct timeval& tm = m_heap.back().m_timestamp;
+	if (timercmp(&tm, &m_released, <))
+	{
+		m_late++;
+	}
+	if (timercmp(&tm, &m_newest, >))
+	{
+		m_newest = tm;
+	}
+	push_heap(m_heap.begin(), m_heap.end());
+}
+
+/**
+ * Release, in timestamp order, the readings that are older than the newest
+ * reading by more than the lateness, and sufficient of the oldest readings
+ * to bring the buffer back within its capacity.
+ *
+ * @param out	The vector to append the released readings to
+ */
+void ReorderBuffer::release(vector<Reading *>& out)
+{
+	struct timeval lateness, horizon;
+	lateness.tv_sec = m_lateness / 1000;
+	lateness.tv_usec = (m_lateness % 1000) * 1000;
+	timersub(&m_newest, &lateness, &horizon);
+	while (!m_heap.empty() && (m_heap.size() > m_capacity
+				|| !timercmp(&m_heap.front().m_timestamp, &horizon, >)))
+	{
+		pop(out);
+	}
+}
+
+/**
+ * Release all the readings held, in timestamp order
+ *
+ * @param out	The vector to append the released readings to
+ */
+void ReorderBuffer::drain(vector<Reading *>& out)
+{
+	while (!m_heap.empty())
+	{
+		pop(out);
+	}
+}
+
+/**
+ * Release the oldest reading held
+ *
+ * @param out	The vector to append the released reading to
+ */
+void ReorderBuffer::pop(vector<Reading *>& out)
+{
+	pop_heap(m_heap.begin(), m_heap.end());
+	Entry& oldest = m_heap.back();
+	if (timercmp(&oldest.m_timestamp, &m_released, >))
+	{
+		m_released = oldest.m_timestamp;
+	}
+	out.push_back(oldest.m_reading);
+	m_bytes -= oldest.m_bytes;
+	m_heap.pop_back();
+}
+
+/**
+ * The heap used by the buffer and the readings it holds
+ *
+ * @return	The number of bytes of heap used
+ */
+size_t ReorderBuffer::bytes() const
+{
+	return m_bytes + (m_heap.capacity() ? heapBytes(m_heap.capacity() * sizeof(Entry)) : 0);
+}
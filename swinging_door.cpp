@@ -0,0 +1,120 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <swinging_door.h>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+/**
+ * Construct a swinging door compressor with no archived point
+ *
+ * @param deviation	The maximum deviation of a value from the archived line
+ */
+SwingingDoor::SwingingDoor(double deviation) : m_deviation(deviation)
+{
+	reset();
+}
+
+/**
+ * Forget the archived point so that the next value is archived
+ */
+void SwingingDoor::reset()
+{
+	m_open = false;
+	m_archiveTime = m_archiveValue = 0.0;
+	m_lastTime = m_lastValue = 0.0;
+	m_lastInteger = false;
+	m_upper = m_lower = 0.0;
+	m_stringSent = false;
+}
+
+/**
+ * Archive a point and open the doors from it
+ *
+ * @param time		The time of the point in seconds
+ * @param value		The value of the point
+ */
+void SwingingDoor::open(double time, double value)
+{
+	m_open = true;
+	m_archiveTime = time;
+	m_archiveValue = value;
+	m_upper = numeric_limits<double>::infinity();
+	m_lower = -numeric_limits<double>::infinity();
+}
+
+/**
+ * Add a value to the compressor. The doors are the steepest and the
+ * shallowest lines from the archived point that keep every value since
+ * within the deviation. When they cross no single line can represent
+ * the values, the previous value is archived and the doors reopened
+ * from it.
+ *
+ * @param time		The time of the value in seconds
+ * @param value		The value
+ * @param integer	The value was an integer
+ * @return		The point to archive, if any
+ */
+DoorArchive SwingingDoor::update(double time, double value, bool integer)
+{
+DoorArchive	archive = ArchiveNone;
+
+	if (!m_open || time <= m_archiveTime)
+	{
+		// The first value, or one that is out of order, can only be archived itself
+		if (m_open && fabs(value - m_archiveValue) <= m_deviation)
+		{
+			return ArchiveNone;
+		}
+		open(time, value);
+		archive = ArchiveCurrent;
+	}
+	else
+	{
+		double elapsed = time - m_archiveTime;
+		double upper = (value + m_deviation - m_archiveValue) / elapsed;
+		double lower = (value - m_deviation - m_archiveValue) / elapsed;
+		m_upper = upper < m_upper ? upper : m_upper;
+		m_lower = lower > m_lower ? lower : m_lower;
+		if (m_lower > m_upper)
+		{
+			open(m_lastTime, m_lastValue);
+			elapsed = time - m_archiveTime;
+			if (elapsed > 0.0)
+			{
+				m_upper = (value + m_deviation - m_archiveValue) / elapsed;
+				m_lower = (value - m_deviation - m_archiveValue) / elapsed;
+			}
+			archive = ArchivePrevious;
+		}
+	}
+	m_lastTime = time;
+	m_lastValue = value;
+	m_lastInteger = integer;
+	return archive;
+}
+
+/**
+ * Add a string value to the compressor
+ *
+ * @param value	The value
+ * @return	True if the value has changed and should be archived
+ */
+bool SwingingDoor::update(const string& value)
+{
+	if (m_stringSent && value.compare(m_lastString) == 0)
+	{
+		return false;
+	}
+	m_stringSent = true;
+	m_lastString = value;
+	return true;
+}
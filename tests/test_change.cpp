@@ -4,11 +4,16 @@
 #include <filter_plugin.h>
 #include <filter.h>
 #include <string.h>
+#include <unistd.h>
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <rapidjson/document.h>
 #include <reading.h>
 #include <reading_set.h>
 #include <logger.h>
+#include <change_filter.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -21,6 +26,7 @@ extern "C"
 	PLUGIN_HANDLE plugin_init(ConfigCategory *config,
 							  OUTPUT_HANDLE *outHandle,
 							  OUTPUT_STREAM output);
+	void plugin_shutdown(PLUGIN_HANDLE handle);
 	int called = 0;
 
 	void Handler(void *handle, READINGSET *readings)
@@ -31,6 +37,33 @@ extern "C"
 };
 
 
+/**
+ * Create a reading of the asset test with a single datapoint test and a
+ * user timestamp the given number of milliseconds after the start
+ */
+static Reading *timedReading(const struct timeval& start, long ms, long value)
+{
+	DatapointValue dpv(value);
+	Reading *in = new Reading("test", new Datapoint("test", dpv));
+	struct timeval offset, tm;
+	offset.tv_sec = ms / 1000;
+	offset.tv_usec = (ms % 1000) * 1000;
+	timeradd(&start, &offset, &tm);
+	in->setUserTimestamp(tm);
+	return in;
+}
+
+/**
+ * Return the time of a reading in milliseconds after the start
+ */
+static long offsetOf(Reading *reading, const struct timeval& start)
+{
+	struct timeval tm, res;
+	reading->getUserTimestamp(&tm);
+	timersub(&tm, &start, &res);
+	return res.tv_sec * 1000 + res.tv_usec / 1000;
+}
+
 TEST(CHANGE, configuration)
 {
 	// Test case : Configuration is working correctly
@@ -377,3 +410,1920 @@ TEST(CHANGE, average)
 	// TODO : FOGL-8042 - Fix average functionality. Test case for average functionality will be added later
 	
 }
+
+TEST(CHANGE, ArrayPeakTrigger)
+{
+	// Test case : Trigger on the peak of an array datapoint
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "1000");
+	config->setValue("rate", "0");
+	config->setValue("arrayReduction", "peak");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	// First Set of readings establishes the peak of 3
+	vector<Reading *> readings1;
+	vector<double> testValue1 = { 1.0, -3.0, 2.0 };
+	DatapointValue dpv1(testValue1);
+	readings1.push_back(new Reading("test", new Datapoint("test", dpv1)));
+	ReadingSet *readingSet1 = new ReadingSet(&readings1);
+
+	plugin_ingest(handle, (READINGSET *)readingSet1);
+	vector<Reading *> results1 = outReadings->getAllReadings();
+	ASSERT_EQ(results1.size(), 0);
+
+	// Second Set of readings, peak of 4 is within the required change
+	vector<Reading *> readings2;
+	vector<double> testValue2 = { 1.0, 2.0, 4.0, 0.5, -1.0 };
+	DatapointValue dpv2(testValue2);
+	readings2.push_back(new Reading("test", new Datapoint("test", dpv2)));
+	ReadingSet *readingSet2 = new ReadingSet(&readings2);
+
+	plugin_ingest(handle, (READINGSET *)readingSet2);
+	vector<Reading *> results2 = outReadings->getAllReadings();
+	ASSERT_EQ(results2.size(), 0); // trigger condition didn't meet
+
+	// Third Set of readings, peak of 9 triggers
+	vector<Reading *> readings3;
+	vector<double> testValue3 = { 1.0, 2.0, -9.0, 0.5 };
+	DatapointValue dpv3(testValue3);
+	readings3.push_back(new Reading("test", new Datapoint("test", dpv3)));
+	ReadingSet *readingSet3 = new ReadingSet(&readings3);
+
+	plugin_ingest(handle, (READINGSET *)readingSet3);
+	vector<Reading *> results3 = outReadings->getAllReadings();
+	ASSERT_EQ(results3.size(), 1); // trigger condition met
+}
+
+TEST(CHANGE, ArrayAverage)
+{
+	// Test case : Reduced rate average of an array datapoint is element-wise
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "1");
+	config->setValue("rateUnit", "per second");
+	config->setValue("arrayReduction", "mean");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	struct timeval tm;
+	gettimeofday(&tm, NULL);
+	double values[3][3] = { { 1.0, 2.0, 3.0 }, { 3.0, 4.0, 5.0 }, { 5.0, 6.0, 7.0 } };
+	for (int i = 0; i < 3; i++)
+	{
+		vector<double> testValue(values[i], values[i] + 3);
+		DatapointValue dpv(testValue);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		tm.tv_sec += 2 * (i / 2);	// The third reading is after the period ends
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1); // one average at the end of the period
+
+	Datapoint *average = results[0]->getReadingData()[0];
+	ASSERT_EQ(average->getData().getType(), DatapointValue::T_FLOAT_ARRAY);
+	vector<double> *arr = average->getData().getDpArr();
+	ASSERT_EQ(arr->size(), 3);
+	ASSERT_DOUBLE_EQ((*arr)[0], 3.0);
+	ASSERT_DOUBLE_EQ((*arr)[1], 4.0);
+	ASSERT_DOUBLE_EQ((*arr)[2], 5.0);
+}
+
+TEST(CHANGE, DecimateByCount)
+{
+	// Test case : Post-trigger decimation sends 1 in N readings
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("decimation", "by count");
+	config->setValue("fullRatePeriod", "0");
+	config->setValue("decimationInterval", "3");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long testValue1 = 10;
+	DatapointValue dpv1(testValue1);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv1)));
+	for (int i = 0; i < 9; i++)
+	{
+		long testValue = 100;
+		DatapointValue dpv(testValue);
+		readings.push_back(new Reading("test", new Datapoint("test", dpv)));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 3); // trigger reading and 1 in 3 thereafter
+}
+
+TEST(CHANGE, DecimateByTime)
+{
+	// Test case : Post-trigger decimation by time sends a reading per interval after the full rate period
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("decimation", "by time");
+	config->setValue("fullRatePeriod", "200");
+	config->setValue("decimationInterval", "300");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (long ms = 0; ms <= 1050; ms += 50)
+	{
+		readings.push_back(timedReading(start, ms, ms ? 100 : 10));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	long expected[] = { 50, 100, 150, 200, 500, 800 };	// the full rate period then every 300mS
+	ASSERT_EQ(results.size(), 6);
+	for (int i = 0; i < 6; i++)
+	{
+		ASSERT_EQ(offsetOf(results[i], start), expected[i]);
+	}
+}
+
+TEST(CHANGE, DecimateByCurve)
+{
+	// Test case : Post-trigger decimation follows the curve as the time since the change grows
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("decimation", "curve");
+	config->setValue("fullRatePeriod", "0");
+	config->setValue("decimationCurve", "200:2, 500:4");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (long ms = 0; ms <= 1000; ms += 50)
+	{
+		readings.push_back(timedReading(start, ms, ms ? 100 : 10));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	// Every reading for 200mS, 1 in 2 until 500mS then 1 in 4
+	long expected[] = { 50, 100, 150, 200, 250, 350, 450, 550, 750, 950 };
+	ASSERT_EQ(results.size(), 10);
+	for (int i = 0; i < 10; i++)
+	{
+		ASSERT_EQ(offsetOf(results[i], start), expected[i]);
+	}
+}
+
+TEST(CHANGE, ReportByException)
+{
+	// Test case : Only datapoints that change by more than the deadband are sent
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("untriggeredMode", "report by exception");
+	config->setValue("deadband", "0.1");
+	config->setValue("deadbands", "b:10");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	double values[3][2] = { { 1.0, 1.0 }, { 1.05, 5.0 }, { 1.2, 5.0 } };
+	for (int i = 0; i < 3; i++)
+	{
+		vector<Datapoint *> datapoints;
+		long testValue = 10;
+		DatapointValue dpv(testValue);
+		datapoints.push_back(new Datapoint("test", dpv));
+		DatapointValue dpva(values[i][0]);
+		datapoints.push_back(new Datapoint("a", dpva));
+		DatapointValue dpvb(values[i][1]);
+		datapoints.push_back(new Datapoint("b", dpvb));
+		readings.push_back(new Reading("test", datapoints));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2); // first reading in full and one change
+	ASSERT_EQ(results[0]->getDatapointCount(), 3);
+	ASSERT_EQ(results[1]->getDatapointCount(), 1);
+	ASSERT_STREQ(results[1]->getReadingData()[0]->getName().c_str(), "a");
+}
+
+TEST(CHANGE, OutputBudget)
+{
+	// Test case : Triggered readings beyond the output budget are shed
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("budget", "5");
+	config->setValue("budgetUnit", "readings per second");
+	config->setValue("budgetBurst", "1");
+	config->setValue("budgetAction", "decimate");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long testValue1 = 10;
+	DatapointValue dpv1(testValue1);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv1)));
+	for (int i = 0; i < 20; i++)
+	{
+		long testValue = 100;
+		DatapointValue dpv(testValue);
+		readings.push_back(new Reading("test", new Datapoint("test", dpv)));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 5); // the burst allowed by the budget
+	ASSERT_EQ(((ChangeFilter *)handle)->getShedReadings(), 15);
+}
+
+TEST(CHANGE, MinimumHold)
+{
+	// Test case : A change must persist for the minimum hold before triggering
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("minimumHold", "500");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 100, 10, 100, 100, 100 };
+	long offsets[] = { 0, 100, 200, 300, 900, 1000 };	// milliseconds
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 6; i++)
+	{
+		DatapointValue dpv(values[i]);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = offsets[i] / 1000;
+		offset.tv_usec = (offsets[i] % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2); // triggered after the change was held for 500mS
+}
+
+TEST(CHANGE, MaximumWindow)
+{
+	// Test case : Further changes do not extend the triggered window beyond the maximum
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "1000");
+	config->setValue("rate", "0");
+	config->setValue("maximumWindow", "500");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	// Changes at 100, 200 and 300mS would extend the window to 1300mS
+	vector<Reading *> readings;
+	long values[] = { 10, 100, 10, 100 };
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (long ms = 0; ms <= 2000; ms += 100)
+	{
+		readings.push_back(timedReading(start, ms, values[ms < 300 ? ms / 100 : 3]));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 6); // the window ends 500mS after the first change
+	ASSERT_EQ(offsetOf(results[0], start), 100);
+	ASSERT_EQ(offsetOf(results.back(), start), 600);
+	ASSERT_EQ(((ChangeFilter *)handle)->getTriggerCount(), 1);
+}
+
+TEST(CHANGE, RearmHoldoff)
+{
+	// Test case : Changes during the re-arm holdoff do not trigger
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "100");
+	config->setValue("rate", "0");
+	config->setValue("rearmHoldoff", "2000");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 100, 100, 10, 10 };
+	long offsets[] = { 0, 0, 500, 1000, 3000 };	// milliseconds
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 5; i++)
+	{
+		DatapointValue dpv(values[i]);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = offsets[i] / 1000;
+		offset.tv_usec = (offsets[i] % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2); // the first change and the change after the holdoff
+	struct timeval tm;
+	results[1]->getUserTimestamp(&tm);
+	ASSERT_EQ(tm.tv_sec, start.tv_sec + 3);
+}
+
+static atomic<int> slowStarted(0), slowDone(0);
+
+/**
+ * An output that takes a while to accept the readings
+ */
+static void SlowHandler(void *handle, READINGSET *readings)
+{
+	slowStarted++;
+	usleep(300000);
+	delete (ReadingSet *)readings;
+	slowDone++;
+}
+
+TEST(CHANGE, IdleFlush)
+{
+	// Test case : The average is sent at the end of the period when the asset is idle
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("rate", "2");
+	config->setValue("rateUnit", "per second");
+	config->setValue("idleFlush", "true");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long testValue1 = 10;
+	DatapointValue dpv1(testValue1);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv1)));
+	long testValue2 = 12;
+	DatapointValue dpv2(testValue2);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv2)));
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results1 = outReadings->getAllReadings();
+	ASSERT_EQ(results1.size(), 0); // period has not ended
+
+	int before = called;
+	usleep(800000);
+	ASSERT_EQ(called, before + 1); // average sent by the scheduler
+	vector<Reading *> results2 = outReadings->getAllReadings();
+	ASSERT_EQ(results2.size(), 1);
+	ASSERT_DOUBLE_EQ(results2[0]->getReadingData()[0]->getData().toDouble(), 11.0);
+
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, ShutdownDuringIdleFlush)
+{
+	// Test case : A filter shut down while its idle flush is running is not called again
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("rate", "5");
+	config->setValue("rateUnit", "per second");
+	config->setValue("idleFlush", "true");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, SlowHandler);
+
+	vector<Reading *> readings;
+	DatapointValue dpv((long)10);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv)));
+	ReadingSet *readingSet = new ReadingSet(&readings);
+	vector<Reading *> out;
+	((ChangeFilter *)handle)->ingest(readingSet->getAllReadingsPtr(), out);
+	delete readingSet;
+
+	int started = slowStarted;
+	for (int i = 0; i < 100 && slowStarted == started; i++)
+	{
+		usleep(10000);
+	}
+	ASSERT_EQ(slowStarted, started + 1);	// the idle flush is in the output
+	plugin_shutdown(handle);
+	ASSERT_EQ(slowDone, slowStarted);	// shutdown waited for the flush
+	usleep(500000);				// nothing is left scheduled for the filter
+	ASSERT_EQ(slowStarted, started + 1);
+}
+
+TEST(CHANGE, AlignedPeriods)
+{
+	// Test case : Averages are aligned to the clock with empty periods sent
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("rate", "1");
+	config->setValue("rateUnit", "per second");
+	config->setValue("alignPeriods", "true");
+	config->setValue("emptyPeriods", "no data");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 12, 11, 10 };
+	long offsets[] = { 200, 700, 1100, 3500 };	// milliseconds
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	start.tv_usec = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		DatapointValue dpv(values[i]);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = offsets[i] / 1000;
+		offset.tv_usec = (offsets[i] % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 3); // two periods with data and one empty period
+
+	long counts[] = { 2, 1, 0 };
+	for (int i = 0; i < 3; i++)
+	{
+		struct timeval tm;
+		results[i]->getUserTimestamp(&tm);
+		ASSERT_EQ(tm.tv_sec, start.tv_sec + i);
+		ASSERT_EQ(tm.tv_usec, 0);
+		Datapoint *samples = results[i]->getDatapoint("sampleCount");
+		ASSERT_NE(samples, (Datapoint *)NULL);
+		ASSERT_EQ(samples->getData().toInt(), counts[i]);
+	}
+	ASSERT_DOUBLE_EQ(results[0]->getDatapoint("test")->getData().toDouble(), 11.0);
+}
+
+TEST(CHANGE, AlignedPeriodsRepeat)
+{
+	// Test case : Empty aligned periods repeat the last average with a sample count of zero
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("rate", "1");
+	config->setValue("rateUnit", "per second");
+	config->setValue("alignPeriods", "true");
+	config->setValue("emptyPeriods", "repeat last");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 12, 14, 10 };
+	long offsets[] = { 200, 700, 1100, 4500 };	// milliseconds
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	start.tv_usec = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		readings.push_back(timedReading(start, offsets[i], values[i]));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 4); // two periods with data and two repeats
+
+	long counts[] = { 2, 1, 0, 0 };
+	double averages[] = { 11.0, 14.0, 14.0, 14.0 };
+	for (int i = 0; i < 4; i++)
+	{
+		ASSERT_EQ(offsetOf(results[i], start), i * 1000);
+		Datapoint *samples = results[i]->getDatapoint("sampleCount");
+		ASSERT_NE(samples, (Datapoint *)NULL);
+		ASSERT_EQ(samples->getData().toInt(), counts[i]);
+		ASSERT_DOUBLE_EQ(results[i]->getDatapoint("test")->getData().toDouble(), averages[i]);
+	}
+}
+
+TEST(CHANGE, EarlyEmit)
+{
+	// Test case : The triggered data is sent before the rest of the batch
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("earlyEmit", "true");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long testValue1 = 1;
+	DatapointValue dpv1(testValue1);
+	readings.push_back(new Reading("other", new Datapoint("value", dpv1)));
+	long testValue2 = 10;
+	DatapointValue dpv2(testValue2);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv2)));
+	long testValue3 = 100;
+	DatapointValue dpv3(testValue3);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv3)));
+	long testValue4 = 2;
+	DatapointValue dpv4(testValue4);
+	readings.push_back(new Reading("other", new Datapoint("value", dpv4)));
+	long testValue5 = 100;
+	DatapointValue dpv5(testValue5);
+	readings.push_back(new Reading("test", new Datapoint("test", dpv5)));
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	int before = called;
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	ASSERT_EQ(called, before + 2); // triggered data and the remainder of the batch
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_STREQ(results[0]->getAssetName().c_str(), "other");
+}
+
+TEST(CHANGE, AsyncOutput)
+{
+	// Test case : Output delivered by the output thread is complete and in order
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("asyncOutput", "true");
+	config->setValue("outputQueueDepth", "2");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	int before = called;
+	for (long i = 0; i < 5; i++)
+	{
+		vector<Reading *> readings;
+		DatapointValue dpv(i);
+		readings.push_back(new Reading("other", new Datapoint("value", dpv)));
+		ReadingSet *readingSet = new ReadingSet(&readings);
+		plugin_ingest(handle, (READINGSET *)readingSet);
+	}
+	plugin_shutdown(handle);	// Drains the output queue
+
+	ASSERT_EQ(called, before + 5);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0]->getReadingData()[0]->getData().toInt(), 4);
+}
+
+TEST(CHANGE, QueueDepthUnderBackpressure)
+{
+	// Test case : The queue statistics may be read while a producer waits for space
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("asyncOutput", "true");
+	config->setValue("outputQueueDepth", "1");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, SlowHandler);
+	ChangeFilter *filter = (ChangeFilter *)handle;
+
+	thread producer([handle] {
+		for (long i = 0; i < 4; i++)
+		{
+			vector<Reading *> readings;
+			DatapointValue dpv(i);
+			readings.push_back(new Reading("other", new Datapoint("value", dpv)));
+			plugin_ingest(handle, (READINGSET *)new ReadingSet(&readings));
+		}
+	});
+	usleep(100000);		// the producer is blocked on the full queue
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	size_t depth = filter->getQueueDepth();
+	filter->getQueueWaitTime();
+	long waited = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+	producer.join();
+	plugin_shutdown(handle);
+	ASSERT_EQ(depth, 1);
+	ASSERT_LT(waited, 50);
+}
+
+TEST(CHANGE, LargeMixedBatch)
+{
+	// Test case : A large mixed batch that repeatedly triggers and ends the window
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	const int count = 50000;
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < count; i++)
+	{
+		long testValue = ((i / 2) % 2) ? 100 : 10;
+		DatapointValue dpv(testValue);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = i / 1000;
+		offset.tv_usec = (i % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+		DatapointValue other(testValue);
+		readings.push_back(new Reading("other", new Datapoint("other", other)));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), count + count / 2 - 1); // every change and every other asset
+}
+
+TEST(CHANGE, ReorderWindow)
+{
+	// Test case : A late reading is put back in order before the trigger is evaluated
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("reorderWindow", "1000");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 10, 10, 100, 10 };
+	long offsets[] = { 0, 200, 300, 100, 2000 };	// milliseconds, the fourth is late
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 5; i++)
+	{
+		DatapointValue dpv(values[i]);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = offsets[i] / 1000;
+		offset.tv_usec = (offsets[i] % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2); // the changes at 100ms and 200ms, the last reading is held
+	struct timeval tm, expected, offset;
+	offset.tv_sec = 0;
+	offset.tv_usec = 200000;
+	timeradd(&start, &offset, &expected);
+	results[1]->getUserTimestamp(&tm);
+	ASSERT_EQ(tm.tv_sec, expected.tv_sec);
+	ASSERT_EQ(tm.tv_usec, expected.tv_usec);
+	ASSERT_EQ(((ChangeFilter *)handle)->getLateReadings(), 0);
+
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, ReorderInterleave)
+{
+	// Test case : Readings released by the reorder buffer keep their place amongst other assets
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("reorderWindow", "100");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 100, 10 };
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 3; i++)
+	{
+		DatapointValue dpv(values[i]);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = 0;
+		offset.tv_usec = i * 200000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+		DatapointValue other((long)i);
+		readings.push_back(new Reading("other", new Datapoint("other", other)));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 4); // the change at 200ms and every other asset
+	ASSERT_STREQ(results[1]->getAssetName().c_str(), "other");
+	ASSERT_STREQ(results[2]->getAssetName().c_str(), "test");
+	ASSERT_EQ(results[3]->getReadingData()[0]->getData().toInt(), 2);
+
+	int before = called;
+	plugin_shutdown(handle);	// Sends the change at 400ms that is still held
+	ASSERT_EQ(called, before + 1);
+	results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1);
+	ASSERT_EQ(results[0]->getReadingData()[0]->getData().toInt(), 10);
+}
+
+TEST(CHANGE, ReorderIdleRelease)
+{
+	// Test case : Readings held for reordering are released when the asset is idle
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("reorderWindow", "200");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 100 };
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 2; i++)
+	{
+		DatapointValue dpv(values[i]);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = 0;
+		offset.tv_usec = i * 50000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results1 = outReadings->getAllReadings();
+	ASSERT_EQ(results1.size(), 0); // both readings are held
+
+	int before = called;
+	usleep(600000);
+	ASSERT_EQ(called, before + 1); // released by the scheduler
+	vector<Reading *> results2 = outReadings->getAllReadings();
+	ASSERT_EQ(results2.size(), 1);
+	ASSERT_EQ(results2[0]->getReadingData()[0]->getData().toInt(), 100);
+
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, PretriggerAdoption)
+{
+	// Test case : The pretrigger buffer adopts readings rather than copying them
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "10000");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	for (int i = 0; i < 6; i++)
+	{
+		long testValue = (i < 5) ? 10 : 100;
+		DatapointValue dpv(testValue);
+		readings.push_back(new Reading("test", new Datapoint("test", dpv)));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 6); // the pretrigger data and the trigger
+	ChangeFilter *filter = (ChangeFilter *)handle;
+	ASSERT_EQ(filter->getAdoptedReadings(), 5);
+	ASSERT_EQ(filter->getAllocatedReadings(), 0);
+	ASSERT_EQ(filter->getAllocatedDatapoints(), 0);
+}
+
+TEST(CHANGE, EventSummary)
+{
+	// Test case : A single summary reading is sent in place of the triggered window
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "1000");
+	config->setValue("postTrigger", "500");
+	config->setValue("rate", "0");
+	config->setValue("eventSummary", "instead of data");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	long values[] = { 10, 10, 100, 120, 90, 90 };
+	long offsets[] = { 0, 100, 200, 300, 400, 1000 };	// milliseconds
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 6; i++)
+	{
+		DatapointValue dpv(values[i]);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = offsets[i] / 1000;
+		offset.tv_usec = (offsets[i] % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1); // only the summary
+	Reading *summary = results[0];
+	ASSERT_EQ(summary->getAssetName().compare("testSummary"), 0);
+	ASSERT_EQ(summary->getDatapoint("previous")->getData().toDouble(), 10.0);
+	ASSERT_EQ(summary->getDatapoint("value")->getData().toDouble(), 100.0);
+	ASSERT_EQ(summary->getDatapoint("delta")->getData().toDouble(), 90.0);
+	ASSERT_EQ(summary->getDatapoint("peak")->getData().toDouble(), 120.0);
+	ASSERT_EQ(summary->getDatapoint("duration")->getData().toInt(), 200);
+	ASSERT_EQ(summary->getDatapoint("count")->getData().toInt(), 3);
+}
+
+TEST(CHANGE, WildcardAsset)
+{
+	// Test case : Each asset matching a wildcard is monitored separately
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "pump_*/pressure");
+	config->setValue("assetMatch", "wildcard");
+	config->setValue("trigger", "pressure");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("rate", "0");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	const char *assets[] = { "pump_1/pressure", "pump_2/pressure", "pump_1/pressure",
+				"pump_2/pressure", "pump_1/pressure", "pump_3/flow" };
+	long values[] = { 10, 50, 10, 50, 100, 10 };
+	for (int i = 0; i < 6; i++)
+	{
+		DatapointValue dpv(values[i]);
+		readings.push_back(new Reading(assets[i], new Datapoint("pressure", dpv)));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 2); // the change of pump_1 and the unmatched asset, in arrival order
+	ASSERT_EQ(results[0]->getAssetName().compare("pump_1/pressure"), 0);
+	ASSERT_EQ(results[0]->getDatapoint("pressure")->getData().toInt(), 100);
+	ASSERT_EQ(results[1]->getAssetName().compare("pump_3/flow"), 0);
+}
+
+TEST(CHANGE, MaxAssets)
+{
+	// Test case : The assets seen least recently are forgotten when the limit is reached
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "pump_*");
+	config->setValue("assetMatch", "wildcard");
+	config->setValue("trigger", "pressure");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("maxAssets", "2");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	const char *assets[] = { "pump_1", "pump_2", "pump_1", "pump_3", "pump_1", "pump_2" };
+	long values[] = { 10, 10, 10, 10, 100, 100 };
+	for (int i = 0; i < 6; i++)
+	{
+		DatapointValue dpv(values[i]);
+		readings.push_back(new Reading(assets[i], new Datapoint("pressure", dpv)));
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1); // pump_2 was forgotten so has no baseline
+	ASSERT_EQ(results[0]->getAssetName().compare("pump_1"), 0);
+	ASSERT_EQ(((ChangeFilter *)handle)->getMatchedAssets(), 2);
+	ASSERT_EQ(((ChangeFilter *)handle)->getTriggerCount(), 1);
+
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, MaxAssetsChurn)
+{
+	// Test case : The memory used stays bounded as asset names churn
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "pump_*");
+	config->setValue("assetMatch", "wildcard");
+	config->setValue("trigger", "pressure");
+	config->setValue("rate", "0");
+	config->setValue("maxAssets", "4");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ChangeFilter *filter = (ChangeFilter *)handle;
+
+	size_t footprint = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		vector<Reading *> readings;
+		DatapointValue dpv((long)10);
+		readings.push_back(new Reading("pump_" + to_string(i), new Datapoint("pressure", dpv)));
+		plugin_ingest(handle, (READINGSET *)new ReadingSet(&readings));
+		if (i == 99)
+		{
+			footprint = filter->getFootprint();
+		}
+	}
+	ASSERT_EQ(filter->getMatchedAssets(), 4);
+	ASSERT_LE(filter->getFootprint(), footprint + 1024);
+
+	plugin_shutdown(handle);
+}
+
+static vector<Reading *> *parallelBatch(const struct timeval& start)
+{
+	vector<Reading *> *readings = new vector<Reading *>;
+	char asset[40];
+	for (int i = 0; i < 2000; i++)
+	{
+		if (i % 17 == 0)
+		{
+			strcpy(asset, "valve");
+		}
+		else
+		{
+			snprintf(asset, sizeof(asset), "pump_%d", (i / 3) % 40);
+		}
+		long value = ((i * 7919) % 13) * 10;
+		DatapointValue dpv(value);
+		Reading *in = new Reading(asset, new Datapoint("pressure", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = i / 1000;
+		offset.tv_usec = (i % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings->push_back(in);
+	}
+	return readings;
+}
+
+TEST(CHANGE, ParallelAssets)
+{
+	// Test case : Assets processed in parallel give the same output in the same order
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	void *handles[2];
+	ReadingSet *outReadings[2];
+	for (int i = 0; i < 2; i++)
+	{
+		ConfigCategory *config = new ConfigCategory("change", info->config);
+		ASSERT_NE(config, (ConfigCategory *)NULL);
+		config->setItemsValueFromDefault();
+		config->setValue("asset", "pump_*");
+		config->setValue("assetMatch", "wildcard");
+		config->setValue("trigger", "pressure");
+		config->setValue("change", "50");
+		config->setValue("preTrigger", "2");
+		config->setValue("postTrigger", "5");
+		config->setValue("rate", "0");
+		config->setValue("maxAssets", "30");	// assets are evicted within a batch
+		config->setValue("parallelAssets", i ? "4" : "0");
+		config->setValue("enable", "true");
+		handles[i] = plugin_init(config, &outReadings[i], Handler);
+	}
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int batch = 0; batch < 2; batch++)
+	{
+		struct timeval offset, tm;
+		offset.tv_sec = batch * 2;
+		offset.tv_usec = 0;
+		timeradd(&start, &offset, &tm);
+		for (int i = 0; i < 2; i++)
+		{
+			ReadingSet *readingSet = new ReadingSet(parallelBatch(tm));
+			outReadings[i] = NULL;
+			plugin_ingest(handles[i], (READINGSET *)readingSet);
+			ASSERT_NE(outReadings[i], (ReadingSet *)NULL);
+		}
+		vector<Reading *> serial = outReadings[0]->getAllReadings();
+		vector<Reading *> parallel = outReadings[1]->getAllReadings();
+		ASSERT_GT(serial.size(), 200);
+		ASSERT_EQ(parallel.size(), serial.size());
+		for (size_t i = 0; i < serial.size(); i++)
+		{
+			ASSERT_EQ(parallel[i]->getAssetName().compare(serial[i]->getAssetName()), 0);
+			ASSERT_EQ(parallel[i]->getDatapoint("pressure")->getData().toInt(),
+					serial[i]->getDatapoint("pressure")->getData().toInt());
+		}
+	}
+	ASSERT_EQ(((ChangeFilter *)handles[1])->getTriggerCount(),
+			((ChangeFilter *)handles[0])->getTriggerCount());
+
+	plugin_shutdown(handles[0]);
+	plugin_shutdown(handles[1]);
+}
+
+TEST(CHANGE, SwingingDoor)
+{
+	// Test case : Only the corners of a triangle wave are archived
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "trigger");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "10000");
+	config->setValue("untriggeredMode", "swinging door");
+	config->setValue("deadband", "0.5");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	start.tv_usec = 0;
+	for (int i = 0; i <= 21; i++)
+	{
+		vector<Datapoint *> datapoints;
+		long value = (i <= 10) ? i : 20 - i;
+		DatapointValue dpv(value);
+		datapoints.push_back(new Datapoint("value", dpv));
+		long trigger = (i < 21) ? 1 : 100;
+		DatapointValue dpvt(trigger);
+		datapoints.push_back(new Datapoint("trigger", dpvt));
+		Reading *in = new Reading("test", datapoints);
+		struct timeval tm = start;
+		tm.tv_sec += i;
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 4); // the start, the peak, the last point and the trigger
+	long expected[] = { 0, 10, 20 };
+	for (int i = 0; i < 3; i++)
+	{
+		struct timeval tm;
+		results[i]->getUserTimestamp(&tm);
+		ASSERT_EQ(tm.tv_sec, start.tv_sec + expected[i]);
+		Datapoint *value = results[i]->getDatapoint("value");
+		ASSERT_NE(value, (Datapoint *)NULL);
+		ASSERT_EQ(value->getData().toInt(), (i == 1) ? 10 : 0);
+	}
+}
+
+TEST(CHANGE, Quantiles)
+{
+	// Test case : Streaming quantiles are sent with the reduced rate average
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "1");
+	config->setValue("rateUnit", "per second");
+	config->setValue("quantiles", "0.5, 0.95");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i <= 1000; i++)
+	{
+		vector<Datapoint *> datapoints;
+		long testValue = 1;
+		DatapointValue dpvt(testValue);
+		datapoints.push_back(new Datapoint("test", dpvt));
+		DatapointValue dpv((double)((i * 7919) % 1000 + 1));	// 1 to 1000 in a scattered order
+		datapoints.push_back(new Datapoint("value", dpv));
+		Reading *in = new Reading("test", datapoints);
+		struct timeval offset, tm;
+		offset.tv_sec = (i == 1000) ? 2 : 0;	// The last reading is after the period ends
+		offset.tv_usec = (i == 1000) ? 0 : i * 500;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 1); // one average at the end of the period
+	Datapoint *median = results[0]->getDatapoint("value_p50");
+	ASSERT_NE(median, (Datapoint *)NULL);
+	ASSERT_NEAR(median->getData().toDouble(), 500.0, 20.0);
+	Datapoint *p95 = results[0]->getDatapoint("value_p95");
+	ASSERT_NE(p95, (Datapoint *)NULL);
+	ASSERT_NEAR(p95->getData().toDouble(), 950.0, 20.0);
+}
+
+TEST(CHANGE, ShedAverageQuantiles)
+{
+	// Test case : Averaging shed readings leaves the quantiles of the reduced rate data alone
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "50");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "100");
+	config->setValue("rate", "1");
+	config->setValue("rateUnit", "per second");
+	config->setValue("quantiles", "0.5");
+	config->setValue("budget", "5");
+	config->setValue("budgetUnit", "readings per second");
+	config->setValue("budgetBurst", "1");
+	config->setValue("budgetAction", "average");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	// A triggered window of 20 readings of which 15 are shed, then
+	// untriggered readings until the reduced rate period ends
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 31; i++)
+	{
+		vector<Datapoint *> datapoints;
+		long testValue = i == 0 ? 10 : 100;
+		DatapointValue dpvt(testValue);
+		datapoints.push_back(new Datapoint("test", dpvt));
+		DatapointValue dpv(i > 0 && i <= 20 ? 1000.0 : 10.0);
+		datapoints.push_back(new Datapoint("value", dpv));
+		Reading *in = new Reading("test", datapoints);
+		struct timeval offset, tm;
+		long ms = i <= 20 ? i : (i < 30 ? 200 + i * 10 : 2000);
+		offset.tv_sec = ms / 1000;
+		offset.tv_usec = (ms % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 7); // the budget, the shed average and the reduced rate average
+	Datapoint *shed = results[5]->getDatapoint("value");
+	ASSERT_NE(shed, (Datapoint *)NULL);
+	ASSERT_EQ(shed->getData().toDouble(), 1000.0);
+	ASSERT_EQ(results[5]->getDatapoint("value_p50"), (Datapoint *)NULL);
+	Datapoint *average = results[6]->getDatapoint("value");
+	ASSERT_NE(average, (Datapoint *)NULL);
+	ASSERT_EQ(average->getData().toDouble(), 10.0);
+	Datapoint *median = results[6]->getDatapoint("value_p50");
+	ASSERT_NE(median, (Datapoint *)NULL);
+	ASSERT_EQ(median->getData().toDouble(), 10.0);
+	ASSERT_EQ(((ChangeFilter *)handle)->getShedReadings(), 15);
+}
+
+TEST(CHANGE, AdaptiveRate)
+{
+	// Test case : The reduced rate period lengthens for a flat signal and shortens for an active one
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "0");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "1");
+	config->setValue("rateUnit", "per second");
+	config->setValue("adaptiveRate", "true");
+	config->setValue("minimumInterval", "1000");
+	config->setValue("maximumInterval", "10000");
+	config->setValue("activity", "5");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	int sent[2];
+	for (int phase = 0; phase < 2; phase++)
+	{
+		// 30 seconds of a flat signal then 20 seconds of an active one
+		vector<Reading *> readings;
+		int first = phase == 0 ? 0 : 300;
+		int last = phase == 0 ? 300 : 500;
+		for (int i = first; i < last; i++)
+		{
+			long testValue = (phase == 0 || i % 2 == 0) ? 100 : 110;
+			DatapointValue dpv(testValue);
+			Reading *in = new Reading("test", new Datapoint("test", dpv));
+			struct timeval offset, tm;
+			offset.tv_sec = i / 10;
+			offset.tv_usec = (i % 10) * 100000;
+			timeradd(&start, &offset, &tm);
+			in->setUserTimestamp(tm);
+			readings.push_back(in);
+		}
+		ReadingSet *readingSet = new ReadingSet(&readings);
+		plugin_ingest(handle, (READINGSET *)readingSet);
+		sent[phase] = outReadings->getAllReadings().size();
+	}
+	// The first period uses the rate, the flat signal then stretches it to 10 seconds
+	ASSERT_EQ(sent[0], 3);
+	// Once active the period shrinks back towards one second
+	ASSERT_GE(sent[1], 10);
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, PretriggerCount)
+{
+	// Test case : The pre-trigger buffer holds at most the configured number of readings
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "10");
+	config->setValue("preTrigger", "10000");
+	config->setValue("preTriggerCount", "5");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	// A burst of 1000 readings within the pre-trigger time, then a change
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i <= 1000; i++)
+	{
+		long testValue = (i == 1000) ? 100 : 10;
+		DatapointValue dpv(testValue);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = 0;
+		offset.tv_usec = i * 100;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 6); // the last 5 readings before the change and the change
+	for (int i = 0; i < 5; i++)
+	{
+		ASSERT_EQ(results[i]->getDatapoint("test")->getData().toInt(), 10);
+	}
+	ASSERT_EQ(results[5]->getDatapoint("test")->getData().toInt(), 100);
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, CoalesceOutput)
+{
+	// Test case : Output is held until enough readings are collected and empty sets are not sent
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("rate", "0");
+	config->setValue("coalesceReadings", "10");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	called = 0;
+	int sizes[] = { 3, 3, 3, 3, 0, 0, 3 };
+	for (int batch = 0; batch < 7; batch++)
+	{
+		// Readings of another asset are passed through unaltered
+		vector<Reading *> readings;
+		for (int i = 0; i < sizes[batch]; i++)
+		{
+			long testValue = 10;
+			DatapointValue dpv(testValue);
+			readings.push_back(new Reading("other", new Datapoint("test", dpv)));
+		}
+		ReadingSet *readingSet = new ReadingSet(&readings);
+		plugin_ingest(handle, (READINGSET *)readingSet);
+		ASSERT_EQ(called, batch < 3 ? 0 : 1);
+	}
+	ASSERT_EQ(outReadings->getAllReadings().size(), 12);
+
+	plugin_shutdown(handle);	// The remaining readings are sent on shutdown
+	ASSERT_EQ(called, 2);
+	ASSERT_EQ(outReadings->getAllReadings().size(), 3);
+}
+
+TEST(CHANGE, DisabledAfterCoalesce)
+{
+	// Test case : Readings passed through while disabled follow the output held for coalescing
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("rate", "0");
+	config->setValue("coalesceReadings", "10");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	called = 0;
+	for (int batch = 0; batch < 2; batch++)
+	{
+		if (batch == 1)
+		{
+			((ChangeFilter *)handle)->disableFilter();
+		}
+		vector<Reading *> readings;
+		for (int i = 0; i < 3; i++)
+		{
+			long testValue = batch * 3 + i;
+			DatapointValue dpv(testValue);
+			readings.push_back(new Reading("other", new Datapoint("test", dpv)));
+		}
+		ReadingSet *readingSet = new ReadingSet(&readings);
+		plugin_ingest(handle, (READINGSET *)readingSet);
+	}
+	ASSERT_EQ(called, 1);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_EQ(results.size(), 6);	// the held output then the readings passed through
+	for (int i = 0; i < 6; i++)
+	{
+		ASSERT_EQ(results[i]->getDatapoint("test")->getData().toInt(), i);
+	}
+
+	plugin_shutdown(handle);
+	ASSERT_EQ(called, 1);	// nothing was left held
+}
+
+TEST(CHANGE, FlightRecorder)
+{
+	// Test case : The decisions of the filter are written to the recorder file on shutdown
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "10");
+	config->setValue("preTrigger", "1000");
+	config->setValue("postTrigger", "1000");
+	config->setValue("rate", "0");
+	config->setValue("recorderFile", "/tmp/change_recorder_test.csv");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+
+	// A change at 5 seconds followed by a steady value
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 10; i++)
+	{
+		long testValue = (i < 5) ? 10 : 20;
+		DatapointValue dpv(testValue);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = i;
+		offset.tv_usec = 0;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	unlink("/tmp/change_recorder_test.csv");
+	plugin_shutdown(handle);
+
+	FILE *fp = fopen("/tmp/change_recorder_test.csv", "r");
+	ASSERT_NE(fp, (FILE *)NULL);
+	vector<string> events;
+	char line[200];
+	while (fgets(line, sizeof(line), fp))
+	{
+		// The event is the fourth field
+		string record(line);
+		size_t field = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			field = record.find(',', field) + 1;
+		}
+		events.push_back(record.substr(field, record.find(',', field) - field));
+	}
+	fclose(fp);
+	unlink("/tmp/change_recorder_test.csv");
+	ASSERT_EQ(events.size(), 4);
+	ASSERT_EQ(events[0], "event");
+	ASSERT_EQ(events[1], "trigger");
+	ASSERT_EQ(events[2], "pretrigger");
+	ASSERT_EQ(events[3], "end");
+}
+
+TEST(CHANGE, RecorderFileName)
+{
+	// Test case : The default recorder file is named safely and links are not followed
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("pump 1/../change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ChangeFilter *filter = (ChangeFilter *)handle;
+
+	setenv("FLEDGE_DATA", "/tmp", 1);
+	ASSERT_EQ(filter->defaultRecorderFile(), "/tmp/pump_1____change_recorder.csv");
+	unsetenv("FLEDGE_DATA");
+
+	unlink("/tmp/change_recorder_link.csv");
+	ASSERT_EQ(symlink("/tmp/change_recorder_target.csv", "/tmp/change_recorder_link.csv"), 0);
+	ASSERT_FALSE(filter->dumpRecorder("/tmp/change_recorder_link.csv"));
+	ASSERT_NE(access("/tmp/change_recorder_target.csv", F_OK), 0);
+	unlink("/tmp/change_recorder_link.csv");
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, MemoryFootprint)
+{
+	// Test case : The footprint grows by the readings held in the pre-trigger buffer and the ring that holds them
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "1000");
+	config->setValue("preTrigger", "3600000");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ChangeFilter *filter = (ChangeFilter *)handle;
+
+	size_t footprint = filter->getFootprint();
+	size_t held = 0;
+	{
+		vector<Reading *> readings;
+		struct timeval start;
+		gettimeofday(&start, NULL);
+		for (int i = 0; i < 10000; i++)
+		{
+			vector<Datapoint *> datapoints;
+			long testValue = 1;
+			DatapointValue dpvt(testValue);
+			datapoints.push_back(new Datapoint("test", dpvt));
+			DatapointValue dpv((double)i);
+			datapoints.push_back(new Datapoint("a_longer_datapoint_name", dpv));
+			Reading *in = new Reading("test", datapoints);
+			struct timeval offset, tm;
+			offset.tv_sec = i / 1000;
+			offset.tv_usec = (i % 1000) * 1000;
+			timeradd(&start, &offset, &tm);
+			in->setUserTimestamp(tm);
+			held += readingBytes(in);
+			readings.push_back(in);
+		}
+		ReadingSet *readingSet = new ReadingSet(&readings);
+		plugin_ingest(handle, (READINGSET *)readingSet);
+		delete outReadings;
+	}
+	// The ring doubles from 16 slots, each slot holds a reading and its size
+	size_t ring = heapBytes(16384 * (sizeof(Reading *) + sizeof(size_t)));
+	ASSERT_EQ(filter->getFootprint() - footprint, held + ring);
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, MemoryLimit)
+{
+	// Test case : The pre-trigger data is reduced to keep the filter within its memory limit
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "10");
+	config->setValue("preTrigger", "3600000");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("memoryLimit", "256");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ChangeFilter *filter = (ChangeFilter *)handle;
+
+	// 10000 readings followed by a change
+	vector<Reading *> readings;
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i <= 10000; i++)
+	{
+		long testValue = (i == 10000) ? 100 : 10;
+		DatapointValue dpv(testValue);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = i / 1000;
+		offset.tv_usec = (i % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+		if (i == 9999)
+		{
+			ReadingSet *readingSet = new ReadingSet(&readings);
+			plugin_ingest(handle, (READINGSET *)readingSet);
+			readings.clear();
+			ASSERT_LE(filter->getFootprint(), 256 * 1024);
+		}
+	}
+	ReadingSet *readingSet = new ReadingSet(&readings);
+	plugin_ingest(handle, (READINGSET *)readingSet);
+	vector<Reading *> results = outReadings->getAllReadings();
+	ASSERT_GT(filter->getMemoryShed(), 0);
+	ASSERT_EQ(results.size(), 10001 - filter->getMemoryShed());
+	ASSERT_GT(results.size(), 100);		// The newest pre-trigger data is kept
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, MemoryLimitCoalesced)
+{
+	// Test case : Output held for coalescing is sent early rather than shedding pre-trigger data
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "test");
+	config->setValue("trigger", "test");
+	config->setValue("change", "10");
+	config->setValue("preTrigger", "3600000");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("coalesceReadings", "1000000");
+	config->setValue("memoryLimit", "1024");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings = NULL;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ChangeFilter *filter = (ChangeFilter *)handle;
+
+	// A pre-trigger buffer within the limit and a large volume of output of other assets
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	int before = called;
+	for (int i = 0; i < 1500; i++)
+	{
+		vector<Reading *> readings;
+		DatapointValue dpv((long)10);
+		Reading *in = new Reading("test", new Datapoint("test", dpv));
+		struct timeval offset, tm;
+		offset.tv_sec = i / 1000;
+		offset.tv_usec = (i % 1000) * 1000;
+		timeradd(&start, &offset, &tm);
+		in->setUserTimestamp(tm);
+		readings.push_back(in);
+		if (i % 20 != 19)
+		{
+			plugin_ingest(handle, (READINGSET *)new ReadingSet(&readings));
+			continue;
+		}
+		for (int j = 0; j < 400; j++)
+		{
+			DatapointValue other((long)j);
+			readings.push_back(new Reading("other", new Datapoint("other", other)));
+		}
+		plugin_ingest(handle, (READINGSET *)new ReadingSet(&readings));
+	}
+	ASSERT_GT(called, before);			// coalesced output was sent early
+	ASSERT_EQ(filter->getMemoryShed(), 0);		// and the pre-trigger data kept
+	ASSERT_LE(filter->getFootprint(), 1024 * 1024);
+	plugin_shutdown(handle);
+}
+
+TEST(CHANGE, MemoryLimitShared)
+{
+	// Test case : The filters of the assets matching a pattern share the memory limit
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory *config = new ConfigCategory("change", info->config);
+	ASSERT_NE(config, (ConfigCategory *)NULL);
+	config->setItemsValueFromDefault();
+	config->setValue("asset", "pump_*");
+	config->setValue("assetMatch", "wildcard");
+	config->setValue("trigger", "test");
+	config->setValue("change", "10");
+	config->setValue("preTrigger", "3600000");
+	config->setValue("postTrigger", "0");
+	config->setValue("rate", "0");
+	config->setValue("memoryLimit", "512");
+	config->setValue("enable", "true");
+
+	ReadingSet *outReadings;
+	void *handle = plugin_init(config, &outReadings, Handler);
+	ChangeFilter *filter = (ChangeFilter *)handle;
+
+	const char *assets[] = { "pump_1", "pump_2", "pump_3", "pump_4" };
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	for (int i = 0; i < 5000; i++)
+	{
+		vector<Reading *> readings;
+		for (int j = 0; j < 4; j++)
+		{
+			DatapointValue dpv((long)10);
+			Reading *in = new Reading(assets[j], new Datapoint("test", dpv));
+			struct timeval offset, tm;
+			offset.tv_sec = i / 1000;
+			offset.tv_usec = (i % 1000) * 1000;
+			timeradd(&start, &offset, &tm);
+			in->setUserTimestamp(tm);
+			readings.push_back(in);
+		}
+		ReadingSet *readingSet = new ReadingSet(&readings);
+		plugin_ingest(handle, (READINGSET *)readingSet);
+	}
+	ASSERT_GT(filter->getMemoryShed(), 0);
+	ASSERT_LE(filter->getFootprint(), 512 * 1024);
+	plugin_shutdown(handle);
+}
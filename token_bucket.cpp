@@ -0,0 +1,89 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <token_bucket.h>
+#include <stddef.h>
+
+/**
+ * Construct a disabled token bucket
+ */
+TokenBucket::TokenBucket() : m_rate(0.0), m_capacity(0.0), m_tokens(0.0)
+{
+	timerclear(&m_last);
+}
+
+/**
+ * Set the rate at which tokens are added and the capacity of the
+ * bucket. The bucket is filled to capacity.
+ *
+ * @param rate		Tokens added per second, 0 disables the bucket
+ * @param capacity	The maximum number of tokens held
+ */
+void TokenBucket::configure(double rate, double capacity)
+{
+	m_rate = rate;
+	m_capacity = capacity < 1.0 ? 1.0 : capacity;
+	m_tokens = m_capacity;
+	gettimeofday(&m_last, NULL);
+}
+
+/**
+ * Add the tokens that have accrued since the bucket was last refilled
+ */
+void TokenBucket::refill()
+{
+struct timeval	now, res;
+
+	gettimeofday(&now, NULL);
+	timersub(&now, &m_last, &res);
+	m_last = now;
+	m_tokens += (res.tv_sec + res.tv_usec / 1000000.0) * m_rate;
+	if (m_tokens > m_capacity)
+	{
+		m_tokens = m_capacity;
+	}
+}
+
+/**
+ * Remove tokens from the bucket if enough are available. A request larger
+ * than the capacity of the bucket is allowed once the bucket is full.
+ *
+ * @param tokens	The number of tokens required
+ * @return		True if the tokens were removed
+ */
+bool TokenBucket::consume(double tokens)
+{
+	if (!enabled())
+	{
+		return true;
+	}
+	refill();
+	if (m_tokens >= tokens || m_tokens >= m_capacity)
+	{
+		m_tokens -= tokens;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Remove tokens from the bucket unconditionally, the bucket may go
+ * into debt that is repaid before further tokens can be consumed.
+ *
+ * @param tokens	The number of tokens to remove
+ */
+void TokenBucket::charge(double tokens)
+{
+	if (!enabled())
+	{
+		return;
+	}
+	refill();
+	m_tokens -= tokens;
+}
@@ -0,0 +1,454 @@
+/*
+ * Fledge "change" filter plugin replay tool.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <filter_plugin.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <change_filter.h>
+#include <rapidjson/document.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cctype>
+#include <unistd.h>
+
+using namespace std;
+using namespace rapidjson;
+
+extern "C" {
+	PLUGIN_INFORMATION *plugin_info();
+	PLUGIN_HANDLE plugin_init(ConfigCategory *config,
+			  OUTPUT_HANDLE *outHandle,
+			  OUTPUT_STREAM output);
+	void plugin_shutdown(PLUGIN_HANDLE handle);
+};
+
+/**
+ * The volume of a stream of readings. The output volume is added to by
+ * the filter's output thread and flush scheduler as well as after ingest,
+ * so the counts are atomic.
+ */
+class Volume {
+	public:
+		Volume() : m_readings(0), m_datapoints(0), m_bytes(0)
+			{
+			};
+		void	add(Reading *reading)
+			{
+				m_readings++;
+				m_datapoints += reading->getDatapointCount();
+				m_bytes += reading->toJSON().size();
+			};
+		std::atomic<unsigned long>	m_readings;
+		std::atomic<unsigned long>	m_datapoints;
+		std::atomic<unsigned long>	m_bytes;
+};
+
+/**
+ * Count and discard the readings the filter sends outside of ingest,
+ * from early emits and idle flushes.
+ *
+ * @param handle	The output volume
+ * @param readingSet	The readings sent
+ */
+static void countOutput(OUTPUT_HANDLE *handle, READINGSET *readingSet)
+{
+	Volume *volume = (Volume *)handle;
+	ReadingSet *readings = (ReadingSet *)readingSet;
+	for (auto reading : readings->getAllReadings())
+	{
+		volume->add(reading);
+	}
+	delete readings;
+}
+
+/**
+ * Parse a timestamp, either in the Fledge format "YYYY-MM-DD HH:MM:SS.ffffff",
+ * taken to be UTC, or as a number of seconds since the epoch.
+ *
+ * @param str	The timestamp
+ * @param tm	The parsed timestamp
+ * @return	True if the timestamp could be parsed
+ */
+static bool parseTimestamp(const string& str, struct timeval& tm)
+{
+	if (str.find('-') == string::npos)
+	{
+		char *end;
+		double seconds = strtod(str.c_str(), &end);
+		if (end == str.c_str())
+		{
+			return false;
+		}
+		tm.tv_sec = (time_t)seconds;
+		tm.tv_usec = (suseconds_t)((seconds - tm.tv_sec) * 1000000);
+		return true;
+	}
+	struct tm parts;
+	memset(&parts, 0, sizeof(parts));
+	const char *rest = strptime(str.c_str(), "%Y-%m-%d %H:%M:%S", &parts);
+	if (!rest)
+	{
+		rest = strptime(str.c_str(), "%Y-%m-%dT%H:%M:%S", &parts);
+	}
+	if (!rest)
+	{
+		return false;
+	}
+	tm.tv_sec = timegm(&parts);
+	tm.tv_usec = 0;
+	if (*rest == '.')
+	{
+		// Take up to six digits of fractional seconds
+		long scale = 100000;
+		for (rest++; isdigit(*rest) && scale > 0; rest++, scale /= 10)
+		{
+			tm.tv_usec += (*rest - '0') * scale;
+		}
+	}
+	return true;
+}
+
+/**
+ * Set the timestamps of a reading. Readings without a timestamp in the
+ * recording keep the time at which they were created.
+ *
+ * @param reading	The reading
+ * @param str		The recorded timestamp
+ */
+static void setTimestamp(Reading *reading, const string& str)
+{
+	struct timeval tm;
+	if (!str.empty() && parseTimestamp(str, tm))
+	{
+		reading->setUserTimestamp(tm);
+		reading->setTimestamp(tm);
+	}
+}
+
+/**
+ * Create a reading from a line of JSON. The line is an object with the
+ * asset name in "asset" or "asset_code", the datapoints in "reading" or
+ * "readings" and an optional timestamp in "user_ts" or "timestamp".
+ *
+ * @param line	The line of JSON
+ * @return	The reading or NULL if the line is not a reading
+ */
+static Reading *parseJSON(const string& line)
+{
+	Document doc;
+	doc.Parse(line.c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		return NULL;
+	}
+	const char *assetKey = doc.HasMember("asset") ? "asset" : "asset_code";
+	const char *readingKey = doc.HasMember("reading") ? "reading" : "readings";
+	if (!doc.HasMember(assetKey) || !doc[assetKey].IsString()
+			|| !doc.HasMember(readingKey) || !doc[readingKey].IsObject())
+	{
+		return NULL;
+	}
+	vector<Datapoint *> datapoints;
+	const Value& values = doc[readingKey];
+	for (Value::ConstMemberIterator member = values.MemberBegin();
+			member != values.MemberEnd(); ++member)
+	{
+		const Value& value = member->value;
+		string name = member->name.GetString();
+		if (value.IsInt64())
+		{
+			DatapointValue dpv((long)value.GetInt64());
+			datapoints.push_back(new Datapoint(name, dpv));
+		}
+		else if (value.IsNumber())
+		{
+			DatapointValue dpv(value.GetDouble());
+			datapoints.push_back(new Datapoint(name, dpv));
+		}
+		else if (value.IsString())
+		{
+			DatapointValue dpv(string(value.GetString()));
+			datapoints.push_back(new Datapoint(name, dpv));
+		}
+		else if (value.IsArray())
+		{
+			vector<double> array;
+			for (Value::ConstValueIterator element = value.Begin();
+					element != value.End(); ++element)
+			{
+				if (element->IsNumber())
+				{
+					array.push_back(element->GetDouble());
+				}
+			}
+			DatapointValue dpv(array);
+			datapoints.push_back(new Datapoint(name, dpv));
+		}
+	}
+	Reading *reading = new Reading(doc[assetKey].GetString(), datapoints);
+	const char *tsKey = doc.HasMember("user_ts") ? "user_ts" : "timestamp";
+	if (doc.HasMember(tsKey))
+	{
+		if (doc[tsKey].IsString())
+		{
+			setTimestamp(reading, doc[tsKey].GetString());
+		}
+		else if (doc[tsKey].IsNumber())
+		{
+			ostringstream ts;
+			ts.precision(17);
+			ts << doc[tsKey].GetDouble();
+			setTimestamp(reading, ts.str());
+		}
+	}
+	return reading;
+}
+
+/**
+ * Split a line of CSV into its fields. Quoted fields are not supported.
+ *
+ * @param line	The line to split
+ */
+static vector<string> splitCSV(const string& line)
+{
+vector<string>	fields;
+string		field;
+istringstream	stream(line);
+
+	while (getline(stream, field, ','))
+	{
+		if (!field.empty() && field[field.size() - 1] == '\r')
+		{
+			field.erase(field.size() - 1);
+		}
+		fields.push_back(field);
+	}
+	return fields;
+}
+
+/**
+ * Create a reading from a line of CSV. The header names the columns,
+ * the column "asset" holds the asset name and the column "timestamp" or
+ * "user_ts" the timestamp. Every other column is a datapoint, empty
+ * fields are omitted.
+ *
+ * @param header	The column names
+ * @param line		The line of CSV
+ * @return		The reading or NULL if the line is not a reading
+ */
+static Reading *parseCSV(const vector<string>& header, const string& line)
+{
+	vector<string> fields = splitCSV(line);
+	string asset, timestamp;
+	vector<Datapoint *> datapoints;
+	for (size_t i = 0; i < fields.size() && i < header.size(); i++)
+	{
+		const string& field = fields[i];
+		if (header[i].compare("asset") == 0)
+		{
+			asset = field;
+		}
+		else if (header[i].compare("timestamp") == 0 || header[i].compare("user_ts") == 0)
+		{
+			timestamp = field;
+		}
+		else if (!field.empty())
+		{
+			char *end;
+			long lval = strtol(field.c_str(), &end, 10);
+			if (*end == '\0')
+			{
+				DatapointValue dpv(lval);
+				datapoints.push_back(new Datapoint(header[i], dpv));
+				continue;
+			}
+			double dval = strtod(field.c_str(), &end);
+			if (*end == '\0')
+			{
+				DatapointValue dpv(dval);
+				datapoints.push_back(new Datapoint(header[i], dpv));
+				continue;
+			}
+			DatapointValue dpv(field);
+			datapoints.push_back(new Datapoint(header[i], dpv));
+		}
+	}
+	if (asset.empty())
+	{
+		for (auto dp : datapoints)
+		{
+			delete dp;
+		}
+		return NULL;
+	}
+	Reading *reading = new Reading(asset, datapoints);
+	setTimestamp(reading, timestamp);
+	return reading;
+}
+
+/**
+ * Print the usage message
+ *
+ * @param name	The name of the program
+ */
+static void usage(const char *name)
+{
+	cerr << "Usage: " << name << " [-f json|csv] [-b batch] [-s item=value]... file" << endl;
+	cerr << "  -f  The format of the file, JSON lines or CSV. The default is" << endl;
+	cerr << "      taken from the file extension." << endl;
+	cerr << "  -b  The number of readings passed to the filter at once, default 100" << endl;
+	cerr << "  -s  Set a configuration item of the filter, may be repeated" << endl;
+}
+
+/**
+ * Replay a file of recorded readings through the change filter and
+ * report the volume of data sent onwards by the filter.
+ */
+int main(int argc, char **argv)
+{
+string		format;
+size_t		batch = 100;
+vector<string>	settings;
+int		opt;
+
+	while ((opt = getopt(argc, argv, "f:b:s:h")) != -1)
+	{
+		switch (opt)
+		{
+			case 'f':
+				format = optarg;
+				break;
+			case 'b':
+				batch = strtoul(optarg, NULL, 10);
+				break;
+			case 's':
+				settings.push_back(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1 || batch == 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	string filename = argv[optind];
+	if (format.empty())
+	{
+		size_t dot = filename.rfind('.');
+		format = (dot != string::npos && filename.substr(dot).compare(".csv") == 0) ? "csv" : "json";
+	}
+	ifstream input(filename);
+	if (!input)
+	{
+		cerr << "Unable to open " << filename << endl;
+		return 1;
+	}
+
+	PLUGIN_INFORMATION *info = plugin_info();
+	ConfigCategory config("change", info->config);
+	config.setItemsValueFromDefault();
+	config.setValue("enable", "true");
+	for (auto& setting : settings)
+	{
+		size_t eq = setting.find('=');
+		if (eq == string::npos || !config.itemExists(setting.substr(0, eq)))
+		{
+			cerr << "Invalid setting " << setting << endl;
+			return 1;
+		}
+		config.setValue(setting.substr(0, eq), setting.substr(eq + 1));
+	}
+
+	Volume in, out;
+	ChangeFilter *filter = (ChangeFilter *)plugin_init(&config, &out, countOutput);
+	chrono::steady_clock::duration elapsed = chrono::steady_clock::duration::zero();
+	vector<string> header;
+	vector<Reading *> readings;
+	vector<Reading *> output;
+	string line;
+	unsigned long lineNo = 0, skipped = 0;
+	bool more = true;
+	while (more)
+	{
+		more = static_cast<bool>(getline(input, line));
+		if (more)
+		{
+			lineNo++;
+			if (line.empty())
+			{
+				continue;
+			}
+			if (format.compare("csv") == 0 && header.empty())
+			{
+				header = splitCSV(line);
+				continue;
+			}
+			Reading *reading = format.compare("csv") == 0 ? parseCSV(header, line) : parseJSON(line);
+			if (!reading)
+			{
+				skipped++;
+				continue;
+			}
+			in.add(reading);
+			readings.push_back(reading);
+		}
+		if (readings.size() >= batch || (!more && !readings.empty()))
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			filter->ingest(&readings, output);
+			elapsed += chrono::steady_clock::now() - start;
+			for (auto reading : output)
+			{
+				out.add(reading);
+				delete reading;
+			}
+			output.clear();
+		}
+	}
+	unsigned long triggers = filter->getTriggerCount();
+	plugin_shutdown(filter);
+
+	double seconds = chrono::duration<double>(elapsed).count();
+	cout << "Input readings:      " << in.m_readings << endl;
+	cout << "Input datapoints:    " << in.m_datapoints << endl;
+	cout << "Input bytes (JSON):  " << in.m_bytes << endl;
+	if (skipped)
+	{
+		cout << "Lines skipped:       " << skipped << " of " << lineNo << endl;
+	}
+	cout << "Output readings:     " << out.m_readings << endl;
+	cout << "Output datapoints:   " << out.m_datapoints << endl;
+	cout << "Output bytes (JSON): " << out.m_bytes << endl;
+	cout << "Triggers:            " << triggers << endl;
+	if (out.m_readings)
+	{
+		cout << "Compression ratio:   " << (double)in.m_readings / out.m_readings
+			<< " (readings), " << (double)in.m_bytes / (out.m_bytes ? out.m_bytes.load() : 1)
+			<< " (bytes)" << endl;
+	}
+	cout << "Filter time:         " << seconds << " seconds" << endl;
+	if (seconds > 0)
+	{
+		cout << "Readings per second: " << (unsigned long)(in.m_readings / seconds) << endl;
+	}
+	return 0;
+}
@@ -0,0 +1,26 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <tracepoints.h>
+
+#ifdef CHANGE_TRACEPOINTS
+/*
+ * The semaphores of the tracepoints. They are placed in the .probes section
+ * where the tracer finds and increments them when it attaches.
+ */
+#define CHANGE_DEFINE_SEMAPHORE(name)	\
+	volatile unsigned short CHANGE_SEMAPHORE(name) __attribute__((unused, section(".probes"))) = 0
+
+CHANGE_DEFINE_SEMAPHORE(ingest_entry);
+CHANGE_DEFINE_SEMAPHORE(ingest_return);
+CHANGE_DEFINE_SEMAPHORE(trigger_fire);
+CHANGE_DEFINE_SEMAPHORE(trigger_expire);
+CHANGE_DEFINE_SEMAPHORE(pretrigger_send);
+CHANGE_DEFINE_SEMAPHORE(average);
+#endif
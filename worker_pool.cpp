@@ -0,0 +1,115 @@
+/*
+ * Fledge "change" filter plugin.
+ *
+ * Copyright (c) 2019 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <worker_pool.h>
+
+using namespace std;
+
+/**
+ * Construct the pool and start the threads
+ *
+ * @param threads	The number of threads that run tasks, including
+ *			the thread that calls run
+ */
+WorkerPool::WorkerPool(unsigned int threads) : m_work(NULL), m_tasks(0), m_next(0),
+				m_active(0), m_generation(0), m_shutdown(false)
+{
+	for (unsigned int i = 1; i < threads; i++)
+	{
+		m_threads.push_back(thread(&WorkerPool::worker, this));
+	}
+}
+
+/**
+ * Stop the threads of the pool
+ */
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+	}
+	m_start.notify_all();
+	for (auto& t : m_threads)
+	{
+		t.join();
+	}
+}
+
+/**
+ * Run a set of tasks, the calling thread runs tasks alongside the threads
+ * of the pool and returns once all the tasks have been run. The order in
+ * which the tasks run is not defined.
+ *
+ * @param tasks	The number of tasks
+ * @param work	Called with the number of each task to run it
+ */
+void WorkerPool::run(size_t tasks, const function<void (size_t)>& work)
+{
+	if (tasks <= 1 || m_threads.empty())
+	{
+		for (size_t i = 0; i < tasks; i++)
+		{
+			work(i);
+		}
+		return;
+	}
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_work = &work;
+		m_tasks = tasks;
+		m_next = 0;
+		m_active = m_threads.size();
+		m_generation++;
+	}
+	m_start.notify_all();
+	execute();
+	unique_lock<mutex> lck(m_mutex);
+	m_done.wait(lck, [this] { return m_active == 0; });
+	m_work = NULL;
+}
+
+/**
+ * The thread of the pool, wait for a set of tasks and help to run them
+ */
+void WorkerPool::worker()
+{
+	unsigned long generation = 0;
+	unique_lock<mutex> lck(m_mutex);
+	while (true)
+	{
+		m_start.wait(lck, [this, generation] {
+				return m_shutdown || m_generation != generation;
+			});
+		if (m_shutdown)
+		{
+			return;
+		}
+		generation = m_generation;
+		lck.unlock();
+		execute();
+		lck.lock();
+		if (--m_active == 0)
+		{
+			m_done.notify_one();
+		}
+	}
+}
+
+/**
+ * Run tasks until none are left unclaimed
+ */
+void WorkerPool::execute()
+{
+	size_t task;
+	while ((task = m_next.fetch_add(1)) < m_tasks)
+	{
+		(*m_work)(task);
+	}
+}